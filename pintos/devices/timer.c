@@ -24,38 +24,76 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
-/* List of sleeping threads sorted by wake_ticks. */
-static struct list sleep_list;
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the PIT count for one timer tick. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot interval the 16-bit PIT counter can hold,
+   in timer ticks. */
+#define ONESHOT_MAX_TICKS (0xffff / PIT_TICK_COUNT)
+
+/* If true, the idle thread stops the periodic tick and programs a
+   one-shot interrupt at the next sleeper's deadline.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Ticks covered by the armed one-shot interval, or 0 if the PIT is
+   in periodic mode. */
+static int64_t oneshot_ticks;
+
+/* Ticks that elapsed in an interrupted one-shot interval but have
+   not yet been run through the wheel.  Folded in by the next timer
+   interrupt, which books them as idle time. */
+static int64_t pending_ticks;
+
+/* Hierarchical timing wheel of sleeping threads.
+
+   Level L has WHEEL_SLOTS buckets, each covering 64**L ticks, so
+   level 0 resolves single ticks and the four levels together span
+   2**24 ticks.  A sleeper goes into the lowest level whose current
+   "window" contains its wake time; when the lower level wraps around,
+   the matching bucket of the level above is cascaded (re-inserted)
+   downward.  Sleepers beyond the top level wait on wheel_overflow.
+
+   Inserting or removing a sleeper is a list_push_back() or
+   list_remove(), so O(1).  timer_interrupt() only drains the current
+   level-0 bucket, plus one higher bucket every 64 ticks.
+
+   wheel_occupied[L] has bit S set iff bucket S of level L is
+   nonempty, which lets the next deadline be found by bit scans. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t wheel_occupied[WHEEL_LEVELS];
+static struct list wheel_overflow;
 
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
-/* Comparison function for sleep_list - wake_ticks ascending, then priority descending */
-static bool cmp_wake (const struct list_elem *a,
-                      const struct list_elem *b, void *aux UNUSED) {
-  const struct thread *ta = list_entry (a, struct thread, elem);
-  const struct thread *tb = list_entry (b, struct thread, elem);
-  if (ta->wake_ticks != tb->wake_ticks) return ta->wake_ticks < tb->wake_ticks;
-  return ta->priority > tb->priority;
-}
+static void wheel_insert (struct thread *);
+static struct thread *wheel_drain (int level, int slot, bool wake);
+static struct thread *wheel_advance (void);
+static struct thread *wheel_higher (struct thread *, struct thread *);
+static void pit_periodic (void);
+static void pit_oneshot (uint16_t count);
+static uint16_t pit_read (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	pit_periodic ();
 
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-	list_init (&sleep_list);
+	for (int level = 0; level < WHEEL_LEVELS; level++)
+		for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+			list_init (&wheel[level][slot]);
+	list_init (&wheel_overflow);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -87,7 +125,7 @@ timer_calibrate (void) {
 int64_t
 timer_ticks (void) {
 	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
+	int64_t t = ticks + pending_ticks;
 	intr_set_level (old_level);
 	barrier ();
 	return t;
@@ -100,15 +138,20 @@ timer_elapsed (int64_t then) {
 	return timer_ticks () - then;
 }
 
-/* Suspends execution for approximately TICKS timer ticks. */
+/* Suspends execution for approximately DURATION timer ticks. */
 void
-timer_sleep (int64_t ticks) {
+timer_sleep (int64_t duration) {
 	ASSERT (intr_get_level () == INTR_ON);
-	if (ticks <= 0) return;
+	if (duration <= 0) return;
 	struct thread *t = thread_current ();
-	t->wake_ticks = timer_ticks () + ticks;
+	t->wake_ticks = timer_ticks () + duration;
 	enum intr_level old = intr_disable ();
-	list_insert_ordered (&sleep_list, &t->elem, cmp_wake, NULL);
+	/* A deadline that already passed, or that falls on the tick
+	   whose bucket was already drained (the sleeper was preempted
+	   before it got here), fires on the next tick. */
+	if (t->wake_ticks <= ticks)
+		t->wake_ticks = ticks + 1;
+	wheel_insert (t);
 	thread_block ();
 	intr_set_level (old);
 }
@@ -140,14 +183,227 @@ timer_print_stats (void) {
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
-	while (!list_empty (&sleep_list)) {
-		struct thread *t = list_entry (list_front (&sleep_list), struct thread, elem);
-		if (t->wake_ticks > ticks) break;
-		list_pop_front (&sleep_list);
-		thread_unblock (t);
+	struct thread *woken = NULL;
+	int64_t idle = pending_ticks;
+	int64_t n;
+
+	/* A one-shot interval stands for several ticks, all but the
+	   last of which the CPU spent idle.  Advance the wheel through
+	   each of them so that no cascade is skipped, but charge them
+	   to the idle thread rather than to whoever is running now. */
+	pending_ticks = 0;
+	if (oneshot_ticks > 0) {
+		idle += oneshot_ticks - 1;
+		oneshot_ticks = 0;
+		pit_periodic ();
+	}
+
+	if (idle > 0) {
+		for (n = 0; n < idle; n++)
+			woken = wheel_higher (woken, wheel_advance ());
+		thread_idle_ticks (idle);
 	}
+	woken = wheel_higher (woken, wheel_advance ());
 	thread_tick ();
+
+	/* Threads woken in the same tick land in the priority-indexed
+	   run queue, so the highest one runs first; preempt if it
+	   outranks the interrupted thread. */
+	if (woken != NULL && woken->eff_priority > thread_current ()->eff_priority)
+		intr_yield_on_return ();
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick by a single
+   interrupt at the earliest sleeper's deadline, limited to what the
+   PIT can count. */
+void
+timer_idle_enter (void) {
+	int64_t now, base, cur, n;
+	uint64_t ahead;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (!timer_tickless || oneshot_ticks > 0)
+		return;
+
+	/* The wheel has only been advanced to TICKS; the PENDING_TICKS
+	   after it are run through at the next interrupt.  Measure the
+	   interval from the real time, and keep ticking if a cascade
+	   or a sleeper in the pending ticks is already overdue. */
+	now = ticks + pending_ticks;
+	if ((now >> WHEEL_BITS) != (ticks >> WHEEL_BITS))
+		return;
+
+	/* Only level-0 buckets are exact; stop at the end of the
+	   current level-0 window, where a cascade may be due. */
+	base = ticks & WHEEL_MASK;
+	cur = now & WHEEL_MASK;
+	n = WHEEL_SLOTS - cur;
+	if (n > ONESHOT_MAX_TICKS)
+		n = ONESHOT_MAX_TICKS;
+	ahead = base == WHEEL_MASK ? 0 : wheel_occupied[0] >> (base + 1);
+	if (ahead != 0) {
+		int64_t next = base + 1 + __builtin_ctzll (ahead);
+		if (next <= cur)
+			return;
+		if (next - cur < n)
+			n = next - cur;
+	}
+	if (n <= 1)
+		return;
+
+	oneshot_ticks = n;
+	pit_oneshot (n * PIT_TICK_COUNT);
+}
+
+/* Called by the scheduler, with interrupts off, when the idle
+   thread gives up the CPU.  If the one-shot interval is still
+   running (some other interrupt woke us), records the whole ticks
+   that elapsed and goes back to the periodic tick.  The partial
+   tick is lost. */
+void
+timer_idle_exit (void) {
+	int64_t elapsed;
+	uint16_t left;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (oneshot_ticks == 0)
+		return;
+
+	/* If the counter already wrapped, its interrupt is pending and
+	   will account for the final tick. */
+	left = pit_read ();
+	if (left > oneshot_ticks * PIT_TICK_COUNT)
+		elapsed = oneshot_ticks - 1;
+	else {
+		elapsed = (oneshot_ticks * PIT_TICK_COUNT - left) / PIT_TICK_COUNT;
+		if (elapsed > oneshot_ticks - 1)
+			elapsed = oneshot_ticks - 1;
+	}
+
+	pending_ticks += elapsed;
+	oneshot_ticks = 0;
+	pit_periodic ();
+}
+
+/* Programs PIT counter 0 to interrupt TIMER_FREQ times per
+   second. */
+static void
+pit_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_TICK_COUNT & 0xff);
+	outb (0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Programs PIT counter 0 to interrupt once, after COUNT input
+   clocks. */
+static void
+pit_oneshot (uint16_t count) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Latches and returns the current value of PIT counter 0. */
+static uint16_t
+pit_read (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* CW: latch counter 0. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return lo | (hi << 8);
+}
+
+/* Advances the clock by one tick, cascading the wheel as needed,
+   and wakes the sleepers due at the new tick.  Returns the
+   highest-priority thread woken, or NULL. */
+static struct thread *
+wheel_advance (void) {
+	ticks++;
+
+	/* Cascade higher levels whose lower level just wrapped,
+	   highest first so that entries can fall all the way down. */
+	if ((ticks & WHEEL_MASK) == 0) {
+		int level = 1;
+		while (level < WHEEL_LEVELS - 1
+		       && ((ticks >> (WHEEL_BITS * level)) & WHEEL_MASK) == 0)
+			level++;
+		if (level == WHEEL_LEVELS - 1
+		    && ((ticks >> (WHEEL_BITS * level)) & WHEEL_MASK) == 0)
+			while (!list_empty (&wheel_overflow))
+				wheel_insert (list_entry (list_pop_front (&wheel_overflow),
+				                          struct thread, elem));
+		for (; level >= 1; level--)
+			wheel_drain (level, (ticks >> (WHEEL_BITS * level)) & WHEEL_MASK,
+			             false);
+	}
+
+	return wheel_drain (0, ticks & WHEEL_MASK, true);
+}
+
+/* Returns whichever of A and B, either of which may be null, has
+   the higher effective priority, preferring A on a tie. */
+static struct thread *
+wheel_higher (struct thread *a, struct thread *b) {
+	if (b != NULL && (a == NULL || b->eff_priority > a->eff_priority))
+		return b;
+	return a;
+}
+
+/* Puts sleeping thread T into the timing wheel according to its
+   wake_ticks, which must not have passed.  A thread due at the
+   current tick, as a cascade can produce, goes into the level-0
+   bucket that wheel_advance() drains next.  Interrupts must be
+   off. */
+static void
+wheel_insert (struct thread *t) {
+	int64_t when = t->wake_ticks;
+	int level, slot;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (when >= ticks);
+
+	/* Pick the lowest level whose current window holds WHEN. */
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		if ((when >> (WHEEL_BITS * (level + 1)))
+		    == (ticks >> (WHEEL_BITS * (level + 1))))
+			break;
+	if (level == WHEEL_LEVELS) {
+		list_push_back (&wheel_overflow, &t->elem);
+		return;
+	}
+
+	slot = (when >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	list_push_back (&wheel[level][slot], &t->elem);
+	wheel_occupied[level] |= 1ULL << slot;
+}
+
+/* Empties bucket SLOT of LEVEL.  If WAKE, unblocks every thread in
+   it and returns the highest-priority one (or NULL if the bucket
+   was empty); otherwise re-inserts each thread one level down and
+   returns NULL. */
+static struct thread *
+wheel_drain (int level, int slot, bool wake) {
+	struct list *bucket = &wheel[level][slot];
+	struct thread *top = NULL;
+
+	if (!(wheel_occupied[level] & (1ULL << slot)))
+		return NULL;
+	wheel_occupied[level] &= ~(1ULL << slot);
+
+	while (!list_empty (bucket)) {
+		struct thread *t = list_entry (list_pop_front (bucket),
+		                               struct thread, elem);
+		if (!wake)
+			wheel_insert (t);
+		else {
+			thread_unblock (t);
+			if (top == NULL || t->eff_priority > top->eff_priority)
+				top = t;
+		}
+	}
+	return top;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -1,11 +1,13 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <hash.h>
+#include <ohash.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -28,7 +30,7 @@ bytes_to_sectors (off_t size) {
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct ohash_elem elem;             /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
@@ -49,14 +51,45 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 		return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, keyed by sector, so that opening a single inode
+ * twice returns the same `struct inode'. */
+static struct ohash open_inodes;
+
+/* Returns a hash value for the inode containing E. */
+static uint64_t
+inode_hash (const struct ohash_elem *e, void *aux UNUSED) {
+	return hash_int (ohash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if the inodes containing A and B are at the same
+ * sector. */
+static bool
+inode_equal (const struct ohash_elem *a, const struct ohash_elem *b,
+		void *aux UNUSED) {
+	return ohash_entry (a, struct inode, elem)->sector
+		== ohash_entry (b, struct inode, elem)->sector;
+}
+
+/* Returns true if the inode containing E is at the sector that
+ * SECTOR points to. */
+static bool
+inode_at_sector (const struct ohash_elem *e, const void *sector,
+		void *aux UNUSED) {
+	return ohash_entry (e, struct inode, elem)->sector
+		== *(const disk_sector_t *) sector;
+}
+
+/* Cache of struct inode.  An inode is a little over a sector, so
+   malloc() would round it up to 1 kB. */
+static struct kmem_cache *inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	ohash_init (&open_inodes, inode_hash, inode_equal, NULL);
+	inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
+	if (inode_cache == NULL)
+		PANIC ("inode_init: out of memory");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,27 +134,26 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct ohash_elem *e;
 	struct inode *inode;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	e = ohash_find_key (&open_inodes, hash_int (sector), inode_at_sector,
+			&sector);
+	if (e != NULL)
+		return inode_reopen (ohash_entry (e, struct inode, elem));
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (inode_cache);
 	if (inode == NULL)
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
+	if (ohash_insert (&open_inodes, &inode->elem) != NULL) {
+		kmem_cache_free (inode_cache, inode);
+		return NULL;
+	}
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
@@ -155,7 +187,7 @@ inode_close (struct inode *inode) {
 	/* Release resources if this was the last opener. */
 	if (--inode->open_cnt == 0) {
 		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+		ohash_remove (&open_inodes, &inode->elem);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -164,7 +196,7 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
+		kmem_cache_free (inode_cache, inode);
 	}
 }
 
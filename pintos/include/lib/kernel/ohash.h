@@ -0,0 +1,105 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+ *
+ * Like the chained table in hash.h, this table does not allocate
+ * its elements: each structure that can be in an ohash embeds a
+ * struct ohash_elem, and ohash_entry converts back to the outer
+ * structure.  Unlike hash.h, the table itself is a single array
+ * of slots, each holding an element pointer and that element's
+ * hash value, so a lookup is a short linear scan of consecutive
+ * slots instead of a walk down a linked list, and most slots
+ * that do not match are rejected by comparing hashes, without
+ * touching the element.
+ *
+ * Collisions are resolved by Robin Hood linear probing, which
+ * keeps every element close to its home slot.  When the table
+ * grows, the old array is not rehashed all at once; instead,
+ * each later operation moves a few of its slots into the new
+ * array, so no single insertion pays for the whole resize.  The
+ * table never shrinks.
+ *
+ * An ohash is not synchronized; callers must provide their own
+ * locking. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hash element. */
+struct ohash_elem {
+	uint64_t hash;              /* Cached hash value. */
+};
+
+/* Converts pointer to hash element OHASH_ELEM into a pointer to
+ * the structure that OHASH_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the hash element. */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+	((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->hash            \
+		- offsetof (STRUCT, MEMBER.hash)))
+
+/* Computes and returns the hash value for hash element E, given
+ * auxiliary data AUX. */
+typedef uint64_t ohash_hash_func (const struct ohash_elem *e, void *aux);
+
+/* Returns true if hash elements A and B have equal keys, given
+ * auxiliary data AUX. */
+typedef bool ohash_equal_func (const struct ohash_elem *a,
+		const struct ohash_elem *b,
+		void *aux);
+
+/* Returns true if hash element E has key KEY, given auxiliary
+ * data AUX.  Used by ohash_find_key(). */
+typedef bool ohash_match_func (const struct ohash_elem *e, const void *key,
+		void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+ * data AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* A slot in an ohash array.  ELEM is null for an empty slot. */
+struct ohash_slot {
+	uint64_t hash;              /* ELEM's hash value. */
+	struct ohash_elem *elem;    /* Element, or null. */
+};
+
+/* Array of slots. */
+struct ohash_array {
+	struct ohash_slot *slots;   /* Slots, or null if none allocated. */
+	size_t slot_cnt;            /* Number of slots, a power of 2. */
+	size_t elem_cnt;            /* Number of elements. */
+};
+
+/* Hash table. */
+struct ohash {
+	struct ohash_array cur;     /* Array that receives insertions. */
+	struct ohash_array old;     /* Array being moved into CUR, if any. */
+	size_t moved;               /* Slots of OLD already moved. */
+	ohash_hash_func *hash;      /* Hash function. */
+	ohash_equal_func *equal;    /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `hash' and `equal'. */
+};
+
+/* Basic life cycle. */
+void ohash_init (struct ohash *, ohash_hash_func *, ohash_equal_func *,
+		void *aux);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find_key (struct ohash *, uint64_t hash,
+		ohash_match_func *, const void *key);
+struct ohash_elem *ohash_delete (struct ohash *, struct ohash_elem *);
+void ohash_remove (struct ohash *, struct ohash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+
+/* Information. */
+size_t ohash_size (const struct ohash *);
+bool ohash_empty (const struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,109 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Ordered set (red-black tree).
+ *
+ * Like the list and hash table, this tree does not use dynamic
+ * allocation: each structure that can be in a tree embeds a
+ * struct rb_elem member, and the rb_entry macro converts a tree
+ * element back to the enclosing structure.  Refer to
+ * lib/kernel/list.h for a detailed explanation of the technique.
+ *
+ * Elements are kept in the order given by the tree's
+ * rb_less_func.  Equal elements are allowed; a new element goes
+ * after the ones equal to it, as with list_insert_ordered().
+ * Running times:
+ *
+ *   rb_insert(), rb_remove()        O(log n)
+ *   rb_find(), rb_lower_bound(),
+ *     rb_upper_bound()              O(log n)
+ *   rb_min(), rb_max()              O(log n)
+ *   rb_next(), rb_prev()            O(log n), O(1) amortized
+ *
+ * The tree does not notice when an element's key changes.
+ * Remove the element, change its key, and insert it again.
+ *
+ * Iterating over a range of keys [LO, HI), where LO_KEY and
+ * HI_KEY are elements holding the bounds:
+ *
+ *   for (e = rb_lower_bound (&tree, &lo_key);
+ *        e != NULL && tree.less (e, &hi_key, tree.aux);
+ *        e = rb_next (e))
+ *     ...
+ *
+ * Augmentation.  A tree may keep extra data in each element that
+ * summarizes the element's subtree, such as the greatest end
+ * address of all the intervals below it.  Supply an
+ * rb_augment_func that recomputes an element's summary from the
+ * element and its two children; the tree calls it bottom-up on
+ * every element whose subtree changes.  If the data the summary
+ * is computed from changes without the key changing, call
+ * rb_augment_update() on the element. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem {
+	struct rb_elem *parent;     /* Parent, or null for the root. */
+	struct rb_elem *left;       /* Left child, or null. */
+	struct rb_elem *right;      /* Right child, or null. */
+	bool red;                   /* Red or black. */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)               \
+	((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent     \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Recomputes the augmented data of tree element E from E itself
+   and from its children E->left and E->right, either of which
+   may be null, given auxiliary data AUX. */
+typedef void rb_augment_func (struct rb_elem *e, void *aux);
+
+/* Red-black tree. */
+struct rbtree {
+	struct rb_elem *root;       /* Root, or null if empty. */
+	size_t elem_cnt;            /* Number of elements. */
+	rb_less_func *less;         /* Comparison function. */
+	rb_augment_func *augment;   /* Augmentation function, or null. */
+	void *aux;                  /* Auxiliary data for `less', `augment'. */
+};
+
+void rb_init (struct rbtree *, rb_less_func *, rb_augment_func *,
+		void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rbtree *, struct rb_elem *);
+void rb_remove (struct rbtree *, struct rb_elem *);
+void rb_augment_update (struct rbtree *, struct rb_elem *);
+
+/* Search. */
+struct rb_elem *rb_find (const struct rbtree *, const struct rb_elem *);
+struct rb_elem *rb_lower_bound (const struct rbtree *,
+		const struct rb_elem *);
+struct rb_elem *rb_upper_bound (const struct rbtree *,
+		const struct rb_elem *);
+
+/* Traversal. */
+struct rb_elem *rb_min (const struct rbtree *);
+struct rb_elem *rb_max (const struct rbtree *);
+struct rb_elem *rb_next (struct rb_elem *);
+struct rb_elem *rb_prev (struct rb_elem *);
+
+/* Information. */
+size_t rb_size (const struct rbtree *);
+bool rb_empty (const struct rbtree *);
+
+#endif /* lib/kernel/rbtree.h */
@@ -0,0 +1,40 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+/* Lock contention statistics.
+
+   Compiled in only when LOCKSTAT is defined, e.g. by adding
+   -DLOCKSTAT to DEFINES in the project's Make.vars.  Otherwise
+   struct lock and struct semaphore carry no extra fields and
+   lock_init_named() and sema_init_named() are plain lock_init()
+   and sema_init().
+
+   Locks are grouped into classes by the name given at init
+   time, so that e.g. all the malloc descriptor locks of one
+   block size share a line in the report.  Times are in TSC
+   cycles. */
+
+#ifdef LOCKSTAT
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Statistics for one class of locks. */
+struct lockstat {
+	const char *name;           /* Class name. */
+	long long acquired;         /* Successful acquisitions. */
+	long long contended;        /* Acquisitions that had to wait. */
+	long long donations;        /* Priority donations through the lock. */
+	uint64_t wait_total;        /* Cycles spent waiting. */
+	uint64_t wait_max;
+	uint64_t hold_total;        /* Cycles held (locks only). */
+	uint64_t hold_max;
+};
+
+struct lockstat *lockstat_lookup (const char *name);
+void lockstat_record_wait (struct lockstat *, uint64_t cycles, bool contended);
+void lockstat_record_hold (struct lockstat *, uint64_t cycles);
+void lockstat_record_donation (struct lockstat *);
+void lockstat_print (void);
+#endif /* LOCKSTAT */
+
+#endif /* threads/lockstat.h */
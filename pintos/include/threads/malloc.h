@@ -4,10 +4,22 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Maximum number of malloc() size classes. */
+#define MALLOC_CLASS_MAX 11
+
+/* A thread's cache of free blocks of one size class, so that
+   most malloc() and free() calls need no lock.  See malloc.c. */
+struct malloc_magazine {
+	void *top;                  /* Most recently cached block, or null. */
+	unsigned cnt;               /* Number of blocks cached. */
+};
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_print_stats (void);
 
 #endif /* threads/malloc.h */
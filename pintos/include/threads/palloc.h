@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -19,5 +20,12 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_extend_multiple (void *, size_t page_cnt, size_t new_cnt);
+bool palloc_prezero (void);
+void palloc_user_range (void **base, size_t *page_cnt);
+size_t palloc_free_blocks (enum palloc_flags, int order);
+void palloc_zero_stats (enum palloc_flags, unsigned long long *hits,
+		unsigned long long *misses);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -1,13 +1,19 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/lockstat.h"
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
 	struct list waiters;        /* List of waiting threads. */
+#ifdef LOCKSTAT
+	struct lockstat *stat;      /* Statistics class, or null. */
+#endif
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -16,11 +22,25 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Something a thread holds that waiters donate priority
+   through: a lock, or the writer's or one reader's share of an
+   rwlock.  Kept in the holder's held_locks heap, ordered by the
+   highest priority in DONORS. */
+struct lock_hold {
+	struct heap_elem elem;      /* Element in holder's held_locks. */
+	struct heap *donors;        /* Waiters, by effective priority. */
+};
+
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
-	struct list_elem elem;
+	struct heap donors;         /* Waiters, by effective priority. */
+	struct lock_hold hold;      /* Holder's share. */
+#ifdef LOCKSTAT
+	struct lockstat *stat;      /* Statistics class. */
+	uint64_t acquired_tsc;      /* TSC when the holder acquired it. */
+#endif
 };
 
 void lock_init (struct lock *);
@@ -29,6 +49,54 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Named variants, which give the lock or semaphore its own line
+   in the lockstat report.  NAME must outlive the lock. */
+#ifdef LOCKSTAT
+void sema_init_named (struct semaphore *, unsigned value, const char *name);
+void lock_init_named (struct lock *, const char *name);
+#else
+#define sema_init_named(SEMA, VALUE, NAME) sema_init (SEMA, VALUE)
+#define lock_init_named(LOCK, NAME) lock_init (LOCK)
+#endif
+
+/* Reader-writer lock.
+   Any number of readers or a single writer may hold it.  With
+   writer preference, a waiting writer keeps new readers out, so
+   that a steady stream of readers cannot starve it; without, a
+   reader gets in whenever no writer holds the lock.  Every
+   waiter donates its priority to every current holder. */
+struct rwlock {
+	struct thread *writer;      /* Writer holding lock, or null. */
+	struct list readers;        /* Reader shares (rwlock_read_hold). */
+	struct list read_waiters;   /* Waiting readers' shares. */
+	struct list write_waiters;  /* Waiting writers. */
+	struct heap donors;         /* All waiters, by effective priority. */
+	struct lock_hold write_hold; /* Writer's share. */
+	bool prefer_writers;        /* Writer preference? */
+};
+
+/* One reader's share of an rwlock.  The reader supplies it,
+   usually on its stack, when it acquires the lock for reading,
+   and must keep it until it releases the lock with it, so a
+   thread may hold any number of read locks. */
+struct rwlock_read_hold {
+	struct lock_hold hold;      /* Reader's share. */
+	struct list_elem elem;      /* Element in rwlock's readers or
+	                               read_waiters. */
+	struct rwlock *rwlock;      /* Lock held. */
+	struct thread *thread;      /* Reader. */
+};
+
+void rwlock_init (struct rwlock *, bool prefer_writers);
+void rwlock_acquire_read (struct rwlock *, struct rwlock_read_hold *);
+bool rwlock_try_acquire_read (struct rwlock *, struct rwlock_read_hold *);
+void rwlock_release_read (struct rwlock *, struct rwlock_read_hold *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_read_held_by_current_thread (const struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
 /* Condition variable. */
 struct condition {
 	struct list waiters;        /* List of waiting threads. */
@@ -42,10 +110,8 @@ void cond_broadcast (struct condition *, struct lock *);
 /* Priority donation helper functions */
 void recompute_eff_priority(struct thread *);
 void requeue_ready_list(struct thread *);
-bool higher_priority_donate(const struct list_elem *, const struct list_elem *, void *);
-void remove_donators_related_lock(struct thread *, struct lock *);
-bool is_contain(struct list *, struct list_elem *);
-void propagate_eff_priority(void);
+bool held_lock_less(const struct heap_elem *, const struct heap_elem *, void *);
+void propagate_eff_priority(struct thread *);
 bool cond_sema_priority_compare(const struct list_elem *, const struct list_elem *, void *);
 
 /* Optimization barrier.
@@ -2,9 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/fixed-point.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -28,6 +32,38 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, used by the MLFQS scheduler. */
+#define NICE_MIN -20                    /* Most favorable to others. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least favorable to others. */
+
+/* Why a thread gave up the CPU. */
+enum sched_leave {
+	SCHED_PREEMPT,                      /* Preempted (time slice or priority). */
+	SCHED_BLOCK,                        /* Blocked, e.g. on a semaphore. */
+	SCHED_YIELD,                        /* Called thread_yield(). */
+	SCHED_EXIT,                         /* Exited. */
+	SCHED_LEAVE_CNT
+};
+
+/* Per-thread scheduling statistics, in TSC cycles.
+   Maintained by the scheduler with interrupts off. */
+struct sched_stats {
+	uint64_t ready_tsc;                 /* When it last became READY. */
+	uint64_t run_tsc;                   /* When it was last dispatched. */
+	uint64_t wait_cycles;               /* Total time READY but not running. */
+	uint64_t run_cycles;                /* Total time on the CPU. */
+	uint64_t max_wake_latency;          /* Longest wake-to-run delay. */
+	unsigned dispatches;                /* # of times dispatched. */
+	unsigned leaves[SCHED_LEAVE_CNT];   /* # of times it left, by reason. */
+	bool woken;                         /* READY because of thread_unblock(). */
+};
+
+/* Number of log2 buckets in the wake-to-run latency histogram.
+   Bucket B counts latencies of [2**B, 2**(B+1)) cycles; bucket 0
+   also holds 0 and the last bucket everything above. */
+#define SCHED_HIST_BUCKETS 40
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -96,10 +132,24 @@ struct thread {
 	/* 우선순위 기부 관련 필드들 */
 	int base_priority;                  /* 기본 우선순위 (thread_set_priority로 설정) */
 	int eff_priority;                   /* 유효 우선순위 (기부받은 우선순위 포함) */
-	struct list donators;               /* 나에게 우선순위를 기부한 스레드들의 리스트 */
-	struct list_elem donate_elem;       /* 내가 다른 스레드의 donators 리스트에 들어갈 때 사용하는 요소 */
+	struct heap_elem donate_elem;       /* 기다리는 락의 donors 힙에 들어갈 때 사용하는 요소 */
 	struct lock *waiting_lock;          /* 내가 현재 기다리고 있는 락 */
-	struct list held_locks;             /* 내가 현재 보유하고 있는 락들의 리스트 */
+	struct rwlock *waiting_rwlock;      /* 내가 현재 기다리고 있는 rwlock */
+	struct heap held_locks;             /* 보유 중인 락들의 힙 (락의 최고 대기자 우선순위 기준) */
+	int ready_priority;                 /* READY일 때 들어 있는 run queue의 우선순위 */
+
+	/* MLFQS (-mlfqs) 관련 필드들 */
+	int nice;                           /* 양보 성향 (NICE_MIN ~ NICE_MAX) */
+	fixed_t recent_cpu;                 /* 최근에 사용한 CPU 시간 (17.14 고정소수점) */
+	struct list_elem allelem;           /* all_list용 요소 */
+	bool cpu_charged;                   /* 마지막 우선순위 계산 후 recent_cpu가 늘었는지 */
+	struct list_elem charged_elem;      /* charged_list용 요소 */
+
+	struct sched_stats sched;           /* 스케줄링 지연 추적 */
+
+	/* malloc() 크기 클래스별 빈 블록 캐시 (malloc.c 소유) */
+	struct malloc_magazine malloc_mags[MALLOC_CLASS_MAX];
+	size_t malloc_mag_bytes;            /* malloc_mags에 든 블록들의 총 바이트 수 */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
@@ -127,6 +177,7 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_idle_ticks (int64_t);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -136,11 +187,18 @@ void thread_block (void);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
+
+/* Performs some operation on thread t, given auxiliary data AUX. */
+typedef void thread_action_func (struct thread *t, void *aux);
+void thread_foreach (thread_action_func *, void *);
+
 tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
+void thread_preemption (void);
 void requeue_ready_list(struct thread *);
 
 int thread_get_priority (void);
@@ -153,6 +211,10 @@ bool thread_priority_compare (const struct list_elem *a, const struct list_elem
 void thread_donate_priority (struct thread *t);
 void thread_update_priority (struct thread *t);
 
+void thread_print_sched_stats (void);
+void thread_sched_stats (struct sched_stats *);
+void thread_sched_histogram (uint64_t hist[SCHED_HIST_BUCKETS]);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
@@ -9,5 +9,9 @@ int process_exec (void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
+#ifdef VM
+void segment_get (void *aux);
+void segment_put (void *aux);
+#endif
 
 #endif /* userprog/process.h */
@@ -4,10 +4,17 @@
 struct page;
 enum vm_type;
 
+/* No swap slot. */
+#define SWAP_NONE ((size_t) -1)
+
 struct anon_page {
+	size_t slot;           /* Swap slot holding the page, or SWAP_NONE. */
+	bool prefetch;         /* Being read in around another page's fault. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_share_slot (struct page *page, struct page *src);
+void anon_print_stats (void);
 
 #endif
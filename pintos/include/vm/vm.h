@@ -1,6 +1,7 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <stdint.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -36,6 +37,15 @@ struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Marks an uninit page whose AUX is the struct segment of the ELF
+ * segment it belongs to, shared with the segment's other pages;
+ * see userprog/process.c. */
+#define VM_SEGMENT VM_MARKER_1
+
+/* Marks the anonymous page at the top of a process's stack; see
+ * setup_stack() in userprog/process.c. */
+#define VM_STACK VM_MARKER_0
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -46,6 +56,9 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	bool writable;         /* May user code write to the page? */
+	struct thread *owner;  /* Thread whose page table maps it. */
+	struct page *next_sharer;  /* Next page sharing FRAME. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -62,7 +75,9 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct page *page;     /* First of the pages that map the frame. */
+	unsigned share_cnt;    /* Number of pages that map the frame. */
+	bool pinned;           /* In use for I/O; not to be evicted. */
 };
 
 /* The function table for page operations.
@@ -82,11 +97,18 @@ struct page_operations {
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ * A 4-level radix tree indexed by virtual page number, shaped
+ * like the x86-64 page table; see vm/spt.c. */
 struct supplemental_page_table {
+	uintptr_t root;        /* Top-level node, tagged with its entry count. */
+	size_t page_cnt;       /* Pages in the table. */
+	size_t node_cnt;       /* Tree nodes, one page each. */
+	size_t swap_hint;      /* Swap slot to try first for the next page. */
 };
 
+/* Performs some operation on PAGE, given auxiliary data AUX. */
+typedef void spt_action_func (struct page *page, void *aux);
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -96,8 +118,15 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+void spt_detach_page (struct supplemental_page_table *spt, struct page *page);
+void spt_walk (struct supplemental_page_table *spt, void *start, void *end,
+		spt_action_func *action, void *aux);
+void spt_clear_range (struct supplemental_page_table *spt, void *start,
+		void *end, spt_action_func *action, void *aux);
+void spt_print_stats (void);
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -107,6 +136,7 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_prefetch_page (struct page *page);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
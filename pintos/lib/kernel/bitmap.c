@@ -63,6 +63,52 @@ last_mask (const struct bitmap *b) {
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a bit mask of the bits of element ELEM_IDX that fall
+   in bitmap bits START through END, exclusive. */
+static inline elem_type
+range_mask (size_t elem_idx, size_t start, size_t end) {
+	size_t base = elem_idx * ELEM_BITS;
+	size_t lo = start > base ? start - base : 0;
+	size_t hi = end < base + ELEM_BITS ? end - base : ELEM_BITS;
+	elem_type mask = hi < ELEM_BITS ? ((elem_type) 1 << hi) - 1 : (elem_type) -1;
+
+	return mask & ~(((elem_type) 1 << lo) - 1);
+}
+
+/* Returns the number of 1-bits in X.  Computed by adding up bit
+   fields of doubling width, which avoids the popcnt instruction
+   and the libgcc helper that the kernel cannot link against. */
+static inline size_t
+popcount (elem_type x) {
+	x = x - ((x >> 1) & 0x5555555555555555UL);
+	x = (x & 0x3333333333333333UL) + ((x >> 2) & 0x3333333333333333UL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (x * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or the size of B if there is none.  Skips
+   whole elements that hold no such bit. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value) {
+	elem_type flip = value ? 0 : (elem_type) -1;
+	size_t idx, bit;
+	elem_type e;
+
+	if (start >= b->bit_cnt)
+		return b->bit_cnt;
+
+	idx = elem_idx (start);
+	e = (b->bits[idx] ^ flip) & ~(bit_mask (start) - 1);
+	while (e == 0) {
+		if (++idx >= elem_cnt (b->bit_cnt))
+			return b->bit_cnt;
+		e = b->bits[idx] ^ flip;
+	}
+	bit = idx * ELEM_BITS + __builtin_ctzl (e);
+	return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -194,48 +240,67 @@ bitmap_set_all (struct bitmap *b, bool value) {
 	bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Elements only partly in the range are updated atomically, like
+   bitmap_mark() and bitmap_reset(); whole elements are stored. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
+	size_t idx;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	if (cnt == 0)
+		return;
+	for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++) {
+		elem_type mask = range_mask (idx, start, end);
+
+		if (mask == (elem_type) -1)
+			b->bits[idx] = value ? (elem_type) -1 : 0;
+		else if (value)
+			asm ("lock orq %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+		else
+			asm ("lock andq %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+	}
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i, value_cnt;
+	size_t end = start + cnt;
+	size_t idx, one_cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
-	return value_cnt;
+	if (cnt == 0)
+		return 0;
+	one_cnt = 0;
+	for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+		one_cnt += popcount (b->bits[idx] & range_mask (idx, start, end));
+	return value ? one_cnt : cnt - one_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	elem_type flip = value ? 0 : (elem_type) -1;
+	size_t end = start + cnt;
+	size_t idx;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
+	if (cnt == 0)
+		return false;
+	for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+		if ((b->bits[idx] ^ flip) & range_mask (idx, start, end))
 			return true;
 	return false;
 }
@@ -266,18 +331,33 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Walks the bitmap run by run: find the next bit set to VALUE,
+   then the next bit after it that is not, and check the length
+   of the run in between.  Both searches skip whole elements, so
+   the cost is linear in the number of elements and runs, not in
+   the number of bits times CNT. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
-	if (cnt <= b->bit_cnt) {
-		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
-				return i;
+	if (cnt > b->bit_cnt)
+		return BITMAP_ERROR;
+	if (cnt == 0)
+		return start <= b->bit_cnt - cnt ? start : BITMAP_ERROR;
+
+	while (start + cnt <= b->bit_cnt) {
+		size_t run_start = find_next (b, start, value);
+		size_t run_end;
+
+		if (run_start + cnt > b->bit_cnt)
+			break;
+		run_end = find_next (b, run_start + 1, !value);
+		if (run_end - run_start >= cnt)
+			return run_start;
+		start = run_end;
 	}
 	return BITMAP_ERROR;
 }
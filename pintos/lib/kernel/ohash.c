@@ -0,0 +1,366 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Robin Hood hashing (Celis, 1986).  An element's probe distance
+   is how far its slot is past its home slot, HASH modulo the
+   array size.  Insertion walks forward from the home slot and,
+   whenever it passes an element closer to its own home than the
+   one being inserted, swaps the two and carries on inserting the
+   displaced element.  This evens out probe distances, and it
+   lets a lookup stop as soon as it reaches an element that is
+   closer to home than the key would be at that point.  Deletion
+   shifts the following run of displaced elements back by one
+   slot, so no tombstones are left behind.
+
+   Growing allocates an array twice as large and makes it CUR;
+   the previous array becomes OLD.  Every later operation first
+   moves the next MOVE_STEP slots of OLD into CUR, and OLD is
+   freed once it has been swept.  Until then, an element may be
+   in either array, so lookups check CUR and then OLD.  Moving an
+   element out of OLD, or deleting one from it, leaves a
+   tombstone, because backward shifting could pull an unmoved
+   element into the part already swept.  Growth happens at a
+   load factor of 7/8, and by the time OLD is swept CUR is at
+   most half full, so a resize is always finished before the
+   next one is due. */
+
+/* Initial number of slots. */
+#define MIN_SLOTS 16
+
+/* Slots of OLD moved into CUR per operation. */
+#define MOVE_STEP 8
+
+/* Marks a deleted element in OLD. */
+#define TOMBSTONE ((struct ohash_elem *) 1)
+
+static size_t lookup (struct ohash *, const struct ohash_array *,
+		uint64_t hash, ohash_match_func *, const void *key);
+static void place (struct ohash_array *, uint64_t hash, struct ohash_elem *);
+static void erase (struct ohash_array *, size_t idx);
+static bool grow (struct ohash *);
+static void move_some (struct ohash *);
+static struct ohash_elem *find_and_delete (struct ohash *, uint64_t hash,
+		ohash_match_func *, const void *key, bool delete);
+static bool same_elem (const struct ohash_elem *, const void *, void *);
+
+/* Returned by lookup() when no slot matches. */
+#define NO_SLOT SIZE_MAX
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using EQUAL, given auxiliary data AUX.
+   No memory is allocated until the first insertion. */
+void
+ohash_init (struct ohash *h,
+		ohash_hash_func *hash, ohash_equal_func *equal, void *aux) {
+	ASSERT (h != NULL);
+	ASSERT (hash != NULL);
+	ASSERT (equal != NULL);
+
+	h->cur.slots = h->old.slots = NULL;
+	h->cur.slot_cnt = h->old.slot_cnt = 0;
+	h->cur.elem_cnt = h->old.elem_cnt = 0;
+	h->moved = 0;
+	h->hash = hash;
+	h->equal = equal;
+	h->aux = aux;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash.  DESTRUCTOR may, if appropriate,
+   deallocate the memory used by the hash element, but it must
+   not modify H. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor) {
+	if (destructor != NULL)
+		ohash_apply (h, destructor);
+	free (h->cur.slots);
+	free (h->old.slots);
+	ohash_init (h, h->hash, h->equal, h->aux);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW.
+   If the table must grow and memory is not available, returns
+   NEW itself without inserting it. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new) {
+	uint64_t hash = h->hash (new, h->aux);
+	struct ohash_elem *old;
+
+	move_some (h);
+	old = find_and_delete (h, hash, NULL, new, false);
+	if (old != NULL)
+		return old;
+
+	/* Grow at 7/8 full.  If that fails, we can still fill the
+	   array up to one empty slot, which ends every probe. */
+	if ((ohash_size (h) + 1) * 8 > h->cur.slot_cnt * 7
+			&& !grow (h) && h->cur.elem_cnt + 1 >= h->cur.slot_cnt)
+		return new;
+
+	new->hash = hash;
+	place (&h->cur, hash, new);
+	return NULL;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct ohash_elem *
+ohash_find (struct ohash *h, struct ohash_elem *e) {
+	move_some (h);
+	return find_and_delete (h, h->hash (e, h->aux), NULL, e, false);
+}
+
+/* Finds and returns an element of hash table H for which MATCH
+   returns true given KEY, or a null pointer if there is none.
+   HASH must be the hash value of the elements that match KEY.
+   This avoids building a whole dummy element just to look one
+   up. */
+struct ohash_elem *
+ohash_find_key (struct ohash *h, uint64_t hash,
+		ohash_match_func *match, const void *key) {
+	ASSERT (match != NULL);
+
+	move_some (h);
+	return find_and_delete (h, hash, match, key, false);
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, struct ohash_elem *e) {
+	move_some (h);
+	return find_and_delete (h, h->hash (e, h->aux), NULL, e, true);
+}
+
+/* Removes E, which must be in hash table H, from H.  Unlike
+   ohash_delete(), this finds E by address using the hash value
+   cached in E, without calling the hash or comparison function,
+   so it works even if E's key has since changed. */
+void
+ohash_remove (struct ohash *h, struct ohash_elem *e) {
+	struct ohash_elem *found;
+
+	move_some (h);
+	found = find_and_delete (h, e->hash, same_elem, e, true);
+	ASSERT (found == e);
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.  Modifying hash table H while ohash_apply() is running,
+   using any of the functions ohash_insert(), ohash_find(),
+   ohash_delete(), ohash_remove(), or ohash_destroy(), yields
+   undefined behavior, whether done from ACTION or elsewhere. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action) {
+	size_t i;
+
+	ASSERT (action != NULL);
+
+	for (i = 0; i < h->cur.slot_cnt; i++)
+		if (h->cur.slots[i].elem != NULL)
+			action (h->cur.slots[i].elem, h->aux);
+	for (i = 0; i < h->old.slot_cnt; i++)
+		if (h->old.slots[i].elem != NULL && h->old.slots[i].elem != TOMBSTONE)
+			action (h->old.slots[i].elem, h->aux);
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (const struct ohash *h) {
+	return h->cur.elem_cnt + h->old.elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (const struct ohash *h) {
+	return ohash_size (h) == 0;
+}
+
+/* Returns the probe distance of the element in slot IDX of A. */
+static inline size_t
+distance (const struct ohash_array *a, size_t idx) {
+	return (idx - a->slots[idx].hash) & (a->slot_cnt - 1);
+}
+
+/* Searches array A of hash table H for an element with hash
+   value HASH for which MATCH returns true given KEY, or, if MATCH
+   is null, that H's comparison function finds equal to element
+   KEY.  Returns its slot index, or NO_SLOT if there is none.
+   Tombstones are skipped. */
+static size_t
+lookup (struct ohash *h, const struct ohash_array *a,
+		uint64_t hash, ohash_match_func *match, const void *key) {
+	size_t mask = a->slot_cnt - 1;
+	size_t idx, dist;
+
+	if (a->slots == NULL)
+		return NO_SLOT;
+
+	for (idx = hash & mask, dist = 0; ; idx = (idx + 1) & mask, dist++) {
+		const struct ohash_slot *s = &a->slots[idx];
+
+		if (s->elem == NULL || distance (a, idx) < dist)
+			return NO_SLOT;
+		if (s->hash == hash && s->elem != TOMBSTONE
+				&& (match != NULL ? match (s->elem, key, h->aux)
+					: h->equal (s->elem, key, h->aux)))
+			return idx;
+	}
+}
+
+/* Finds an element with hash value HASH that matches KEY in
+   either array of H, as for lookup(), and returns it, or a null
+   pointer if there is none.  If DELETE is true, also removes
+   it. */
+static struct ohash_elem *
+find_and_delete (struct ohash *h, uint64_t hash,
+		ohash_match_func *match, const void *key, bool delete) {
+	struct ohash_elem *found;
+	size_t idx;
+
+	idx = lookup (h, &h->cur, hash, match, key);
+	if (idx != NO_SLOT) {
+		found = h->cur.slots[idx].elem;
+		if (delete)
+			erase (&h->cur, idx);
+		return found;
+	}
+
+	idx = lookup (h, &h->old, hash, match, key);
+	if (idx != NO_SLOT) {
+		found = h->old.slots[idx].elem;
+		if (delete) {
+			h->old.slots[idx].elem = TOMBSTONE;
+			h->old.elem_cnt--;
+		}
+		return found;
+	}
+	return NULL;
+}
+
+/* Returns true if E is KEY itself. */
+static bool
+same_elem (const struct ohash_elem *e, const void *key, void *aux UNUSED) {
+	return e == key;
+}
+
+/* Inserts E, with hash value HASH, into array A, which must have
+   at least two empty slots. */
+static void
+place (struct ohash_array *a, uint64_t hash, struct ohash_elem *e) {
+	size_t mask = a->slot_cnt - 1;
+	size_t idx, dist;
+
+	ASSERT (a->elem_cnt + 1 < a->slot_cnt);
+
+	for (idx = hash & mask, dist = 0; ; idx = (idx + 1) & mask, dist++) {
+		struct ohash_slot *s = &a->slots[idx];
+		size_t s_dist;
+
+		if (s->elem == NULL) {
+			s->hash = hash;
+			s->elem = e;
+			a->elem_cnt++;
+			return;
+		}
+
+		/* Take the slot from an element that is closer to home,
+		   and go on to place that element instead. */
+		s_dist = distance (a, idx);
+		if (s_dist < dist) {
+			struct ohash_slot displaced = *s;
+
+			s->hash = hash;
+			s->elem = e;
+			hash = displaced.hash;
+			e = displaced.elem;
+			dist = s_dist;
+		}
+	}
+}
+
+/* Removes the element in slot IDX of array A, shifting the
+   displaced elements after it back by one slot. */
+static void
+erase (struct ohash_array *a, size_t idx) {
+	size_t mask = a->slot_cnt - 1;
+
+	for (;;) {
+		size_t next = (idx + 1) & mask;
+
+		if (a->slots[next].elem == NULL || distance (a, next) == 0)
+			break;
+		a->slots[idx] = a->slots[next];
+		idx = next;
+	}
+	a->slots[idx].elem = NULL;
+	a->elem_cnt--;
+}
+
+/* Starts moving H's elements into an array twice the size of
+   CUR, first finishing any resize still in progress.  Returns
+   true if successful, false if memory is not available. */
+static bool
+grow (struct ohash *h) {
+	struct ohash_slot *slots;
+	size_t slot_cnt;
+
+	while (h->old.slots != NULL)
+		move_some (h);
+
+	slot_cnt = h->cur.slot_cnt ? h->cur.slot_cnt * 2 : MIN_SLOTS;
+	slots = calloc (slot_cnt, sizeof *slots);
+	if (slots == NULL)
+		return false;
+
+	h->old = h->cur;
+	h->moved = 0;
+	h->cur.slots = slots;
+	h->cur.slot_cnt = slot_cnt;
+	h->cur.elem_cnt = 0;
+	if (h->old.slots == NULL)
+		h->old.slot_cnt = 0;
+	return true;
+}
+
+/* Moves the next MOVE_STEP slots of H's OLD array, if any, into
+   CUR, and frees OLD once all of it has been moved. */
+static void
+move_some (struct ohash *h) {
+	size_t end;
+
+	if (h->old.slots == NULL)
+		return;
+
+	end = h->moved + MOVE_STEP;
+	if (end > h->old.slot_cnt)
+		end = h->old.slot_cnt;
+	for (; h->moved < end; h->moved++) {
+		struct ohash_slot *s = &h->old.slots[h->moved];
+
+		if (s->elem != NULL && s->elem != TOMBSTONE) {
+			place (&h->cur, s->hash, s->elem);
+			s->elem = TOMBSTONE;
+			h->old.elem_cnt--;
+		}
+	}
+
+	if (h->moved == h->old.slot_cnt) {
+		ASSERT (h->old.elem_cnt == 0);
+		free (h->old.slots);
+		h->old.slots = NULL;
+		h->old.slot_cnt = 0;
+		h->moved = 0;
+	}
+}
@@ -0,0 +1,415 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* A red-black tree is a binary search tree in which every node
+   is red or black, a red node has no red children, and every
+   path from a node down to a null child passes through the same
+   number of black nodes.  Together these keep the longest path
+   at most twice the shortest, so the height is O(log n).
+   Insertion and removal follow Cormen et al., "Introduction to
+   Algorithms", chapter 13, with null pointers in place of the
+   sentinel leaf: the fix-up loops carry the parent of the
+   possibly-null node explicitly.
+
+   Augmented data is recomputed on the way up from the lowest
+   element whose subtree changed, which covers every ancestor
+   that can be affected; the fix-up rotations that follow only
+   rearrange nodes below some ancestor, so they recompute just
+   the two nodes they rotate. */
+
+static void rotate_left (struct rbtree *, struct rb_elem *);
+static void rotate_right (struct rbtree *, struct rb_elem *);
+static void insert_fixup (struct rbtree *, struct rb_elem *);
+static void remove_fixup (struct rbtree *, struct rb_elem *,
+		struct rb_elem *parent);
+static void propagate (struct rbtree *, struct rb_elem *);
+
+/* Returns true if E is a red node.  Null children are black. */
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Returns the leftmost element of the subtree rooted at E. */
+static struct rb_elem *
+subtree_min (struct rb_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
+
+/* Returns the rightmost element of the subtree rooted at E. */
+static struct rb_elem *
+subtree_max (struct rb_elem *e) {
+	while (e->right != NULL)
+		e = e->right;
+	return e;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS.  If AUGMENT
+   is non-null, it maintains per-element augmented data.  Both
+   are given auxiliary data AUX. */
+void
+rb_init (struct rbtree *tree, rb_less_func *less, rb_augment_func *augment,
+		void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = NULL;
+	tree->elem_cnt = 0;
+	tree->less = less;
+	tree->augment = augment;
+	tree->aux = aux;
+}
+
+/* Inserts ELEM into TREE, after any elements equal to it. */
+void
+rb_insert (struct rbtree *tree, struct rb_elem *elem) {
+	struct rb_elem **link = &tree->root;
+	struct rb_elem *parent = NULL;
+
+	ASSERT (elem != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		link = tree->less (elem, parent, tree->aux)
+			? &parent->left : &parent->right;
+	}
+
+	elem->parent = parent;
+	elem->left = elem->right = NULL;
+	elem->red = true;
+	*link = elem;
+	tree->elem_cnt++;
+
+	propagate (tree, elem);
+	insert_fixup (tree, elem);
+}
+
+/* Replaces OLD, a child of PARENT or the root if PARENT is null,
+   by NEW in TREE.  Does not update NEW's parent pointer. */
+static void
+replace_child (struct rbtree *tree, struct rb_elem *parent,
+		struct rb_elem *old, struct rb_elem *new) {
+	if (parent == NULL)
+		tree->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+/* Puts subtree V, which may be null, in U's place in TREE. */
+static void
+transplant (struct rbtree *tree, struct rb_elem *u, struct rb_elem *v) {
+	replace_child (tree, u->parent, u, v);
+	if (v != NULL)
+		v->parent = u->parent;
+}
+
+/* Removes ELEM, which must be in TREE, from TREE. */
+void
+rb_remove (struct rbtree *tree, struct rb_elem *elem) {
+	struct rb_elem *x, *x_parent;
+	bool removed_red = elem->red;
+
+	ASSERT (tree->elem_cnt > 0);
+
+	if (elem->left == NULL) {
+		x = elem->right;
+		x_parent = elem->parent;
+		transplant (tree, elem, x);
+	} else if (elem->right == NULL) {
+		x = elem->left;
+		x_parent = elem->parent;
+		transplant (tree, elem, x);
+	} else {
+		/* Two children: move the successor Y, which has no left
+		   child, into ELEM's place. */
+		struct rb_elem *y = subtree_min (elem->right);
+
+		removed_red = y->red;
+		x = y->right;
+		if (y->parent == elem)
+			x_parent = y;
+		else {
+			x_parent = y->parent;
+			transplant (tree, y, x);
+			y->right = elem->right;
+			y->right->parent = y;
+		}
+		transplant (tree, elem, y);
+		y->left = elem->left;
+		y->left->parent = y;
+		y->red = elem->red;
+	}
+	tree->elem_cnt--;
+
+	propagate (tree, x_parent);
+	if (!removed_red)
+		remove_fixup (tree, x, x_parent);
+}
+
+/* Recomputes the augmented data of ELEM, which must be in TREE,
+   and of its ancestors.  Call this after changing data that
+   ELEM's augmented data depends on. */
+void
+rb_augment_update (struct rbtree *tree, struct rb_elem *elem) {
+	propagate (tree, elem);
+}
+
+/* Returns the first element in TREE equal to KEY, or a null
+   pointer if there is none. */
+struct rb_elem *
+rb_find (const struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = rb_lower_bound (tree, key);
+
+	return e != NULL && !tree->less (key, e, tree->aux) ? e : NULL;
+}
+
+/* Returns the first element in TREE that is not less than KEY,
+   or a null pointer if there is none. */
+struct rb_elem *
+rb_lower_bound (const struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root;
+	struct rb_elem *found = NULL;
+
+	while (e != NULL)
+		if (tree->less (e, key, tree->aux))
+			e = e->right;
+		else {
+			found = e;
+			e = e->left;
+		}
+	return found;
+}
+
+/* Returns the first element in TREE that is greater than KEY,
+   or a null pointer if there is none. */
+struct rb_elem *
+rb_upper_bound (const struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root;
+	struct rb_elem *found = NULL;
+
+	while (e != NULL)
+		if (tree->less (key, e, tree->aux)) {
+			found = e;
+			e = e->left;
+		} else
+			e = e->right;
+	return found;
+}
+
+/* Returns the least element in TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_min (const struct rbtree *tree) {
+	return tree->root != NULL ? subtree_min (tree->root) : NULL;
+}
+
+/* Returns the greatest element in TREE, or a null pointer if
+   TREE is empty. */
+struct rb_elem *
+rb_max (const struct rbtree *tree) {
+	return tree->root != NULL ? subtree_max (tree->root) : NULL;
+}
+
+/* Returns the element after E in its tree, or a null pointer if
+   E is the greatest element. */
+struct rb_elem *
+rb_next (struct rb_elem *e) {
+	ASSERT (e != NULL);
+
+	if (e->right != NULL)
+		return subtree_min (e->right);
+	while (e->parent != NULL && e == e->parent->right)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the element before E in its tree, or a null pointer
+   if E is the least element. */
+struct rb_elem *
+rb_prev (struct rb_elem *e) {
+	ASSERT (e != NULL);
+
+	if (e->left != NULL)
+		return subtree_max (e->left);
+	while (e->parent != NULL && e == e->parent->left)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rbtree *tree) {
+	return tree->elem_cnt;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rbtree *tree) {
+	return tree->root == NULL;
+}
+
+/* Recomputes the augmented data of E and all its ancestors. */
+static void
+propagate (struct rbtree *tree, struct rb_elem *e) {
+	if (tree->augment != NULL)
+		for (; e != NULL; e = e->parent)
+			tree->augment (e, tree->aux);
+}
+
+/* Makes X's right child Y the root of X's subtree, with X as
+   Y's left child. */
+static void
+rotate_left (struct rbtree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	y->parent = x->parent;
+	replace_child (tree, x->parent, x, y);
+	y->left = x;
+	x->parent = y;
+
+	if (tree->augment != NULL) {
+		tree->augment (x, tree->aux);
+		tree->augment (y, tree->aux);
+	}
+}
+
+/* Makes X's left child Y the root of X's subtree, with X as Y's
+   right child. */
+static void
+rotate_right (struct rbtree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	y->parent = x->parent;
+	replace_child (tree, x->parent, x, y);
+	y->right = x;
+	x->parent = y;
+
+	if (tree->augment != NULL) {
+		tree->augment (x, tree->aux);
+		tree->augment (y, tree->aux);
+	}
+}
+
+/* Restores the red-black properties after inserting red node Z. */
+static void
+insert_fixup (struct rbtree *tree, struct rb_elem *z) {
+	struct rb_elem *p;
+
+	while ((p = z->parent) != NULL && p->red) {
+		/* P is red, so it is not the root and has a parent G. */
+		struct rb_elem *g = p->parent;
+
+		if (p == g->left) {
+			struct rb_elem *u = g->right;
+
+			if (is_red (u)) {
+				p->red = u->red = false;
+				g->red = true;
+				z = g;
+			} else {
+				if (z == p->right) {
+					rotate_left (tree, p);
+					z = p;
+					p = z->parent;
+				}
+				p->red = false;
+				g->red = true;
+				rotate_right (tree, g);
+			}
+		} else {
+			struct rb_elem *u = g->left;
+
+			if (is_red (u)) {
+				p->red = u->red = false;
+				g->red = true;
+				z = g;
+			} else {
+				if (z == p->left) {
+					rotate_right (tree, p);
+					z = p;
+					p = z->parent;
+				}
+				p->red = false;
+				g->red = true;
+				rotate_left (tree, g);
+			}
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Restores the red-black properties after removing a black node,
+   which left X, a possibly-null child of PARENT, one black node
+   short. */
+static void
+remove_fixup (struct rbtree *tree, struct rb_elem *x,
+		struct rb_elem *parent) {
+	while (x != tree->root && !is_red (x)) {
+		/* X is short a black node, so its sibling W is not null. */
+		if (x == parent->left) {
+			struct rb_elem *w = parent->right;
+
+			if (w->red) {
+				w->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				w = parent->right;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->right)) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right (tree, w);
+					w = parent->right;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->right->red = false;
+				rotate_left (tree, parent);
+				x = tree->root;
+			}
+		} else {
+			struct rb_elem *w = parent->left;
+
+			if (w->red) {
+				w->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				w = parent->left;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->left)) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left (tree, w);
+					w = parent->left;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->left->red = false;
+				rotate_right (tree, parent);
+				x = tree->root;
+			}
+		}
+	}
+	if (x != NULL)
+		x->red = false;
+}
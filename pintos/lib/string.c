@@ -1,5 +1,83 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below move 8-byte words with the x86-64
+   string instructions (rep movsq, rep stosq), after moving
+   single bytes up to the first aligned destination word.  Blocks
+   that are already aligned and a multiple of 8 bytes long, such
+   as whole pages, need no byte moves at all.  Blocks shorter than
+   WIDE_MIN bytes are moved a byte at a time.  The direction flag
+   is clear on entry: the ABI requires it, and the interrupt
+   stubs clear it. */
+#define WIDE_MIN 32
+
+/* A word that may be loaded from any address. */
+typedef uint64_t __attribute__ ((may_alias, aligned (1))) unaligned_word;
+
+/* The string scanning functions below test 8 bytes at a time for
+   a null or wanted byte.  They load only aligned words, except
+   for strcmp()'s second string, and an aligned word never crosses
+   a page boundary, so a scan that runs past the end of a string
+   reads no page that the string does not touch. */
+
+/* A word loaded from an aligned address. */
+typedef uint64_t __attribute__ ((may_alias)) aligned_word;
+
+/* Page size, for strcmp()'s unaligned loads. */
+#define SCAN_PAGE_SIZE 4096
+
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+/* Returns nonzero if word W contains a null byte.  The lowest
+   set bit is the top bit of the first null byte; bits above it
+   may be set even for bytes that are not null. */
+static inline uint64_t
+zero_bytes (uint64_t w) {
+	return (w - ONES) & ~w & HIGHS;
+}
+
+/* Returns the index in its word of the byte flagged by the
+   lowest set bit of ZEROS, a nonzero value of zero_bytes(). */
+static inline size_t
+first_byte (uint64_t zeros) {
+	return __builtin_ctzll (zeros) / 8;
+}
+
+/* Returns true if P is aligned on a word. */
+static inline int
+word_aligned (const void *p) {
+	return ((uintptr_t) p & 7) == 0;
+}
+
+/* Copies CNT bytes from *SRC to *DST and advances both. */
+static inline void
+move_bytes (unsigned char **dst, const unsigned char **src, size_t cnt) {
+	asm volatile ("rep movsb"
+			: "+D" (*dst), "+S" (*src), "+c" (cnt) : : "memory");
+}
+
+/* Copies CNT 8-byte words from *SRC to *DST and advances both. */
+static inline void
+move_words (unsigned char **dst, const unsigned char **src, size_t cnt) {
+	asm volatile ("rep movsq"
+			: "+D" (*dst), "+S" (*src), "+c" (cnt) : : "memory");
+}
+
+/* Stores CNT copies of byte VALUE at *DST and advances it. */
+static inline void
+store_bytes (unsigned char **dst, uint8_t value, size_t cnt) {
+	asm volatile ("rep stosb"
+			: "+D" (*dst), "+c" (cnt) : "a" (value) : "memory");
+}
+
+/* Stores CNT copies of word VALUE at *DST and advances it. */
+static inline void
+store_words (unsigned char **dst, uint64_t value, size_t cnt) {
+	asm volatile ("rep stosq"
+			: "+D" (*dst), "+c" (cnt) : "a" (value) : "memory");
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,8 +89,15 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = *src++;
+	if (size >= WIDE_MIN) {
+		size_t head = -(uintptr_t) dst & 7;
+
+		move_bytes (&dst, &src, head);
+		size -= head;
+		move_words (&dst, &src, size / 8);
+		size %= 8;
+	}
+	move_bytes (&dst, &src, size);
 
 	return dst_;
 }
@@ -27,17 +112,25 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
-		dst += size;
-		src += size;
-		while (size-- > 0)
-			*--dst = *--src;
+	/* Copying forward is safe unless DST starts inside SRC. */
+	if (dst <= src || dst >= src + size)
+		return memcpy (dst_, src_, size);
+
+	/* Otherwise copy backward: the odd bytes at the end, then the
+	   words with the direction flag set. */
+	dst += size;
+	src += size;
+	for (; size % 8 != 0; size--)
+		*--dst = *--src;
+	if (size > 0) {
+		size /= 8;
+		dst -= 8;
+		src -= 8;
+		asm volatile ("std; rep movsq; cld"
+				: "+D" (dst), "+S" (src), "+c" (size) : : "memory");
 	}
 
-	return dst;
+	return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +145,10 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	/* Skip equal words, then find the differing byte. */
+	for (; size >= 8; a += 8, b += 8, size -= 8)
+		if (*(const unaligned_word *) a != *(const unaligned_word *) b)
+			break;
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -71,12 +168,30 @@ strcmp (const char *a_, const char *b_) {
 	ASSERT (a != NULL);
 	ASSERT (b != NULL);
 
-	while (*a != '\0' && *a == *b) {
-		a++;
-		b++;
-	}
+	/* Compare bytes until A is aligned. */
+	for (; !word_aligned (a); a++, b++)
+		if (*a == '\0' || *a != *b)
+			return *a < *b ? -1 : *a > *b;
 
-	return *a < *b ? -1 : *a > *b;
+	for (;;) {
+		size_t i;
+
+		/* Skip words that are equal and have no null byte.  B may
+		   be misaligned, so stop before a word of B that would
+		   cross a page boundary. */
+		while ((uintptr_t) b % SCAN_PAGE_SIZE <= SCAN_PAGE_SIZE - 8) {
+			uint64_t w = *(const aligned_word *) a;
+			if (w != *(const unaligned_word *) b || zero_bytes (w))
+				break;
+			a += 8;
+			b += 8;
+		}
+
+		/* Compare the next word byte by byte. */
+		for (i = 0; i < 8; i++, a++, b++)
+			if (*a == '\0' || *a != *b)
+				return *a < *b ? -1 : *a > *b;
+	}
 }
 
 /* Returns a pointer to the first occurrence of CH in the first
@@ -89,9 +204,17 @@ memchr (const void *block_, int ch_, size_t size) {
 
 	ASSERT (block != NULL || size == 0);
 
-	for (; size-- > 0; block++)
+	for (; size > 0 && !word_aligned (block); size--, block++)
 		if (*block == ch)
 			return (void *) block;
+	for (; size > 0; block += 8) {
+		uint64_t hits = zero_bytes (*(const aligned_word *) block ^ ch * ONES);
+		if (hits) {
+			size_t i = first_byte (hits);
+			return i < size ? (void *) (block + i) : NULL;
+		}
+		size = size > 8 ? size - 8 : 0;
+	}
 
 	return NULL;
 }
@@ -103,16 +226,26 @@ memchr (const void *block_, int ch_, size_t size) {
 char *
 strchr (const char *string, int c_) {
 	char c = c_;
+	uint64_t mask = (unsigned char) c * ONES;
 
 	ASSERT (string);
 
-	for (;;)
+	for (; !word_aligned (string); string++)
 		if (*string == c)
 			return (char *) string;
 		else if (*string == '\0')
 			return NULL;
-		else
-			string++;
+
+	/* Stop at the first word with C or a null byte, which is
+	   whichever comes first. */
+	for (;; string += 8) {
+		uint64_t w = *(const aligned_word *) string;
+		uint64_t hits = zero_bytes (w) | zero_bytes (w ^ mask);
+		if (hits) {
+			string += first_byte (hits);
+			return *string == c ? (char *) string : NULL;
+		}
+	}
 }
 
 /* Returns the length of the initial substring of STRING that
@@ -260,8 +393,15 @@ memset (void *dst_, int value, size_t size) {
 
 	ASSERT (dst != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = value;
+	if (size >= WIDE_MIN) {
+		size_t head = -(uintptr_t) dst & 7;
+
+		store_bytes (&dst, value, head);
+		size -= head;
+		store_words (&dst, (uint8_t) value * 0x0101010101010101ULL, size / 8);
+		size %= 8;
+	}
+	store_bytes (&dst, value, size);
 
 	return dst_;
 }
@@ -270,12 +410,16 @@ memset (void *dst_, int value, size_t size) {
 size_t
 strlen (const char *string) {
 	const char *p;
+	uint64_t zeros;
 
 	ASSERT (string);
 
-	for (p = string; *p != '\0'; p++)
-		continue;
-	return p - string;
+	for (p = string; !word_aligned (p); p++)
+		if (*p == '\0')
+			return p - string;
+	while (!(zeros = zero_bytes (*(const aligned_word *) p)))
+		p += 8;
+	return p - string + first_byte (zeros);
 }
 
 /* If STRING is less than MAXLEN characters in length, returns
@@ -284,9 +428,18 @@ size_t
 strnlen (const char *string, size_t maxlen) {
 	size_t length;
 
-	for (length = 0; string[length] != '\0' && length < maxlen; length++)
-		continue;
-	return length;
+	for (length = 0; length < maxlen && !word_aligned (string + length);
+			length++)
+		if (string[length] == '\0')
+			return length;
+	for (; length < maxlen; length += 8) {
+		uint64_t zeros = zero_bytes (*(const aligned_word *) (string + length));
+		if (zeros) {
+			length += first_byte (zeros);
+			break;
+		}
+	}
+	return length < maxlen ? length : maxlen;
 }
 
 /* Copies string SRC to DST.  If SRC is longer than SIZE - 1
@@ -0,0 +1,157 @@
+/* Sleeps across 64-tick boundaries, where the timer wheel moves
+   sleepers from a higher level down to level 0, and checks that
+   a thread due exactly on a boundary wakes on that tick, ahead of
+   one due a tick later.  Then sleeps for single ticks, right
+   after a tick boundary, while other threads of the same priority
+   keep the CPU busy, so that sleepers get preempted between
+   reading the clock and entering the wheel. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Ticks covered by one level-0 window of the wheel. */
+#define WINDOW 64
+
+/* Threads that sleep for single ticks under load, how many times
+   each sleeps, and threads that provide the load. */
+#define SHORT_SLEEPERS 3
+#define SHORT_SLEEPS 20
+#define SPINNERS 2
+
+struct sleeper
+  {
+    const char *name;
+    int64_t due;                /* Tick to wake at. */
+    int64_t woke;               /* Tick it woke at. */
+  };
+
+static thread_func sleeper_thread;
+static struct sleeper *wake_order[2];
+static int wake_cnt;
+
+static thread_func short_sleeper_thread;
+static thread_func spinner_thread;
+static struct semaphore short_done;
+static volatile bool spinners_stop;
+static int64_t max_short_late;          /* Worst lateness, in ticks. */
+
+/* Returns the first window boundary more than one window after
+   now, so that a sleeper due there starts out above level 0. */
+static int64_t
+next_boundary (void)
+{
+  return (timer_ticks () / WINDOW + 2) * WINDOW;
+}
+
+/* Busy-waits until the start of a tick. */
+static void
+align_to_tick (void)
+{
+  int64_t start = timer_ticks ();
+  while (timer_elapsed (start) == 0)
+    continue;
+}
+
+void
+test_alarm_boundary (void)
+{
+  struct sleeper early, late;
+  int64_t boundary;
+  int i;
+
+  /* Two threads across one boundary.  Create the later one first,
+     so that waking in order does not come from creation order. */
+  align_to_tick ();
+  boundary = next_boundary ();
+  late = (struct sleeper) { "late", boundary + 1, 0 };
+  early = (struct sleeper) { "early", boundary, 0 };
+  thread_create ("late", PRI_DEFAULT, sleeper_thread, &late);
+  thread_create ("early", PRI_DEFAULT, sleeper_thread, &early);
+  timer_sleep (boundary + 5 - timer_ticks ());
+
+  if (wake_cnt != 2)
+    fail ("%d of 2 threads woke up", wake_cnt);
+  if (early.woke != early.due)
+    fail ("thread due at tick %lld woke at tick %lld",
+          (long long) early.due, (long long) early.woke);
+  msg ("thread due on a %d-tick boundary woke on time", WINDOW);
+  if (late.woke != late.due)
+    fail ("thread due at tick %lld woke at tick %lld",
+          (long long) late.due, (long long) late.woke);
+  msg ("thread due one tick later woke on time");
+  if (wake_order[0] != &early)
+    fail ("thread \"%s\" woke first", wake_order[0]->name);
+  msg ("they woke in order");
+
+  /* The main thread, sleeping to several boundaries in a row. */
+  for (i = 0; i < 3; i++)
+    {
+      int64_t due, woke;
+
+      align_to_tick ();
+      due = next_boundary ();
+      timer_sleep (due - timer_ticks ());
+      woke = timer_ticks ();
+      if (woke != due)
+        fail ("sleep to tick %lld woke at tick %lld",
+              (long long) due, (long long) woke);
+      msg ("main thread woke on time at boundary %d", i);
+    }
+
+  /* One-tick sleeps under load.  A sleeper may only be late by
+     the time the other runnable threads take, never by a whole
+     window of the wheel. */
+  sema_init (&short_done, 0);
+  spinners_stop = false;
+  for (i = 0; i < SPINNERS; i++)
+    thread_create ("spinner", PRI_DEFAULT, spinner_thread, NULL);
+  for (i = 0; i < SHORT_SLEEPERS; i++)
+    thread_create ("short", PRI_DEFAULT, short_sleeper_thread, NULL);
+  for (i = 0; i < SHORT_SLEEPERS; i++)
+    sema_down (&short_done);
+  spinners_stop = true;
+
+  if (max_short_late >= WINDOW / 2)
+    fail ("one-tick sleep under load woke %lld ticks late",
+          (long long) max_short_late);
+  msg ("one-tick sleeps under load woke on time");
+}
+
+static void
+sleeper_thread (void *s_)
+{
+  struct sleeper *s = s_;
+
+  timer_sleep (s->due - timer_ticks ());
+  s->woke = timer_ticks ();
+  wake_order[wake_cnt++] = s;
+}
+
+static void
+short_sleeper_thread (void *aux UNUSED)
+{
+  int i;
+
+  align_to_tick ();
+  for (i = 0; i < SHORT_SLEEPS; i++)
+    {
+      int64_t due = timer_ticks () + 1;
+      int64_t late;
+
+      timer_sleep (1);
+      late = timer_ticks () - due;
+      if (late > max_short_late)
+        max_short_late = late;
+    }
+  sema_up (&short_done);
+}
+
+static void
+spinner_thread (void *aux UNUSED)
+{
+  while (!spinners_stop)
+    continue;
+}
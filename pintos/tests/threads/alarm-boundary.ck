@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-boundary) begin
+(alarm-boundary) thread due on a 64-tick boundary woke on time
+(alarm-boundary) thread due one tick later woke on time
+(alarm-boundary) they woke in order
+(alarm-boundary) main thread woke on time at boundary 0
+(alarm-boundary) main thread woke on time at boundary 1
+(alarm-boundary) main thread woke on time at boundary 2
+(alarm-boundary) one-tick sleeps under load woke on time
+(alarm-boundary) end
+EOF
+pass;
@@ -0,0 +1,141 @@
+/* Compares the word-at-a-time bitmap operations against the
+   bit-at-a-time versions they replaced, on a 1 Mbit bitmap that
+   is almost entirely allocated: a free bit every 97 bits, and a
+   single free run of RUN_CNT bits near the end, as in a full,
+   fragmented free map.  Each pair must agree.  Prints the TSC
+   cycles for each, which depend on the machine. */
+
+#include <bitmap.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "intrinsic.h"
+
+#define BIT_CNT (1024 * 1024)
+#define RUN_CNT 16
+
+/* The replaced implementations, built on single-bit access. */
+
+static void
+old_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    bitmap_set (b, start + i, value);
+}
+
+static size_t
+old_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, value_cnt = 0;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+static bool
+old_contains (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      return true;
+  return false;
+}
+
+static size_t
+old_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  if (cnt <= bitmap_size (b))
+    {
+      size_t last = bitmap_size (b) - cnt;
+      size_t i;
+      for (i = start; i <= last; i++)
+        if (!old_contains (b, i, cnt, !value))
+          return i;
+    }
+  return BITMAP_ERROR;
+}
+
+static void
+report (const char *op, uint64_t old_cycles, uint64_t new_cycles)
+{
+  msg ("%-14s old %12llu  new %10llu cycles  (%llux)", op,
+       (unsigned long long) old_cycles, (unsigned long long) new_cycles,
+       (unsigned long long) (new_cycles ? old_cycles / new_cycles : 0));
+}
+
+/* Makes B all true except every 97th bit and the RUN_CNT bits
+   starting at RUN_START. */
+static void
+fragment (struct bitmap *b, size_t run_start)
+{
+  size_t i;
+
+  bitmap_set_all (b, true);
+  for (i = 0; i < BIT_CNT; i += 97)
+    bitmap_reset (b, i);
+  bitmap_set_multiple (b, run_start, RUN_CNT, false);
+}
+
+void
+test_bitmap_bench (void)
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  size_t run_start = BIT_CNT - 1000;
+  uint64_t t0, t1, t2;
+  size_t old_idx, new_idx, old_cnt, new_cnt;
+  bool old_any, new_any;
+
+  if (b == NULL)
+    fail ("couldn't allocate %d-bit bitmap", BIT_CNT);
+
+  t0 = rdtsc ();
+  old_set_multiple (b, 0, BIT_CNT, true);
+  t1 = rdtsc ();
+  bitmap_set_multiple (b, 0, BIT_CNT, true);
+  t2 = rdtsc ();
+  report ("set_multiple", t1 - t0, t2 - t1);
+
+  fragment (b, run_start);
+
+  t0 = rdtsc ();
+  old_cnt = old_count (b, 0, BIT_CNT, false);
+  t1 = rdtsc ();
+  new_cnt = bitmap_count (b, 0, BIT_CNT, false);
+  t2 = rdtsc ();
+  if (old_cnt != new_cnt)
+    fail ("bitmap_count() returned %zu, expected %zu", new_cnt, old_cnt);
+  report ("count", t1 - t0, t2 - t1);
+
+  /* The whole map but the free run is set, so contains(false)
+     over everything before the run scans every element. */
+  bitmap_set_all (b, true);
+  bitmap_set_multiple (b, run_start, RUN_CNT, false);
+  t0 = rdtsc ();
+  old_any = old_contains (b, 0, run_start, false);
+  t1 = rdtsc ();
+  new_any = bitmap_contains (b, 0, run_start, false);
+  t2 = rdtsc ();
+  if (old_any || new_any)
+    fail ("bitmap_contains() found a free bit before the run");
+  report ("contains", t1 - t0, t2 - t1);
+
+  fragment (b, run_start);
+  t0 = rdtsc ();
+  old_idx = old_scan (b, 0, RUN_CNT, false);
+  t1 = rdtsc ();
+  new_idx = bitmap_scan (b, 0, RUN_CNT, false);
+  t2 = rdtsc ();
+  if (old_idx != run_start || new_idx != run_start)
+    fail ("scan found %zu (old) and %zu (new), expected %zu",
+          old_idx, new_idx, run_start);
+  report ("scan", t1 - t0, t2 - t1);
+
+  bitmap_destroy (b);
+  pass ();
+}
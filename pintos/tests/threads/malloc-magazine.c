@@ -0,0 +1,112 @@
+/* Runs several threads that each repeatedly malloc() a batch of
+   blocks of assorted sizes, fill them with a pattern of their
+   own, check that no other thread wrote over them, and free
+   them.  Each thread also frees blocks that the main thread
+   allocated, so blocks move between threads' magazines.  Prints
+   the average TSC cycles per malloc()/free() pair, which depend
+   on the machine. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define THREAD_CNT 4
+#define ROUND_CNT 200
+#define BLOCK_CNT 32
+#define GIFT_CNT 64
+
+struct worker
+  {
+    int id;                     /* Fill pattern. */
+    void *gifts[GIFT_CNT];      /* Blocks from the main thread to free. */
+    uint64_t cycles;            /* Cycles spent in malloc() and free(). */
+    struct semaphore *done;     /* Upped on completion. */
+  };
+
+static struct worker workers[THREAD_CNT];
+static thread_func worker_func;
+
+/* Returns the size of the I'th block, from 6 to 1024 bytes. */
+static size_t
+block_size (int i)
+{
+  return (16 << (i % 7)) - (i % 3) * 5;
+}
+
+void
+test_malloc_magazine (void)
+{
+  struct semaphore done;
+  uint64_t cycles = 0;
+  int i, j;
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      struct worker *w = &workers[i];
+      char name[16];
+
+      w->id = i + 1;
+      w->cycles = 0;
+      w->done = &done;
+      for (j = 0; j < GIFT_CNT; j++)
+        if ((w->gifts[j] = malloc (block_size (j))) == NULL)
+          fail ("main thread's malloc() %d failed", j);
+      snprintf (name, sizeof name, "worker %d", i);
+      thread_create (name, PRI_DEFAULT, worker_func, w);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < THREAD_CNT; i++)
+    cycles += workers[i].cycles;
+  msg ("%d threads did %d malloc()/free() pairs, %llu cycles per pair.",
+       THREAD_CNT, THREAD_CNT * ROUND_CNT * BLOCK_CNT,
+       (unsigned long long) (cycles / (THREAD_CNT * ROUND_CNT * BLOCK_CNT)));
+  pass ();
+}
+
+static void
+worker_func (void *w_)
+{
+  struct worker *w = w_;
+  unsigned char *blocks[BLOCK_CNT];
+  int round, i;
+  size_t k;
+
+  for (i = 0; i < GIFT_CNT; i++)
+    free (w->gifts[i]);
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      uint64_t t0, t1;
+
+      t0 = rdtsc ();
+      for (i = 0; i < BLOCK_CNT; i++)
+        if ((blocks[i] = malloc (block_size (round + i))) == NULL)
+          fail ("thread %d: malloc() failed", w->id);
+      t1 = rdtsc ();
+      w->cycles += t1 - t0;
+
+      for (i = 0; i < BLOCK_CNT; i++)
+        memset (blocks[i], w->id, block_size (round + i));
+      thread_yield ();
+      for (i = 0; i < BLOCK_CNT; i++)
+        for (k = 0; k < block_size (round + i); k++)
+          if (blocks[i][k] != w->id)
+            fail ("thread %d: block %d byte %zu overwritten with %d",
+                  w->id, i, k, blocks[i][k]);
+
+      t0 = rdtsc ();
+      for (i = BLOCK_CNT - 1; i >= 0; i--)
+        free (blocks[i]);
+      t1 = rdtsc ();
+      w->cycles += t1 - t0;
+    }
+  sema_up (w->done);
+}
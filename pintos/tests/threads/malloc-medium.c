@@ -0,0 +1,79 @@
+/* Allocates blocks between 1 and 3 kB, which come from the
+   medium size classes, and checks that they do not overlap.
+   Checks that realloc() keeps a block in place when its size
+   class does not change and when a big block shrinks, and that a
+   big block keeps its contents when it grows, in place or not.
+   Prints the malloc() fragmentation report. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+#define BLOCK_CNT 40
+
+static unsigned char *blocks[BLOCK_CNT];
+
+/* Returns the size of the I'th block. */
+static size_t
+block_size (int i)
+{
+  return 1100 + i * 50;
+}
+
+static void
+check_fill (unsigned char *p, size_t size, int value)
+{
+  size_t k;
+
+  for (k = 0; k < size; k++)
+    if (p[k] != (unsigned char) value)
+      fail ("byte %zu of block %d overwritten with %d", k, value, p[k]);
+}
+
+void
+test_malloc_medium (void)
+{
+  unsigned char *p, *q;
+  int i;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = malloc (block_size (i));
+      if (blocks[i] == NULL)
+        fail ("malloc(%zu) failed", block_size (i));
+      memset (blocks[i], i, block_size (i));
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    check_fill (blocks[i], block_size (i), i);
+  malloc_print_stats ();
+
+  /* Growing by a few bytes stays in the same class. */
+  p = realloc (blocks[0], block_size (0) + 8);
+  if (p != blocks[0])
+    fail ("realloc() within a size class moved the block");
+  blocks[0] = p;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+
+  /* A big block shrinks in place. */
+  p = malloc (3 * PGSIZE);
+  if (p == NULL)
+    fail ("malloc(%d) failed", 3 * PGSIZE);
+  memset (p, 0x5a, 2 * PGSIZE);
+  q = realloc (p, 2 * PGSIZE);
+  if (q != p)
+    fail ("shrinking a big block moved it");
+  check_fill (q, 2 * PGSIZE, 0x5a);
+
+  /* It grows in place only if the pages after it are free. */
+  p = realloc (q, 4 * PGSIZE);
+  if (p == NULL)
+    fail ("realloc(%d) failed", 4 * PGSIZE);
+  msg ("Growing a big block %s.", p == q ? "kept it in place" : "moved it");
+  check_fill (p, 2 * PGSIZE, 0x5a);
+  free (p);
+  pass ();
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(malloc-medium) PASS', @output);
+fail "missing realloc() result in output"
+  unless grep (/^\(malloc-medium\) Growing a big block (kept it in place|moved it)\.$/,
+	       @output);
+
+pass;
@@ -0,0 +1,189 @@
+/* Compares memcpy(), memmove(), memset() and memcmp() against
+   the byte-at-a-time loops they replaced, on a whole page and on
+   an odd-sized, misaligned block.  Each pair must agree.  Prints
+   the TSC cycles for each, which depend on the machine. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define ROUND_CNT 16
+
+/* The replaced implementations. */
+
+static void *
+old_memcpy (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+static void *
+old_memmove (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  if (dst < src)
+    {
+      while (size-- > 0)
+        *dst++ = *src++;
+    }
+  else
+    {
+      dst += size;
+      src += size;
+      while (size-- > 0)
+        *--dst = *--src;
+    }
+  return dst_;
+}
+
+static void *
+old_memset (void *dst_, int value, size_t size)
+{
+  unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+static int
+old_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static void
+report (const char *op, size_t size, uint64_t old_cycles, uint64_t new_cycles)
+{
+  msg ("%-8s %4zu bytes: old %8llu  new %6llu cycles  (%llux)", op, size,
+       (unsigned long long) old_cycles / ROUND_CNT,
+       (unsigned long long) new_cycles / ROUND_CNT,
+       (unsigned long long) (new_cycles ? old_cycles / new_cycles : 0));
+}
+
+/* Fills SIZE bytes at P with a pattern that depends on SEED. */
+static void
+fill (unsigned char *p, size_t size, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = i * 7 + seed;
+}
+
+/* Runs each operation on SIZE bytes, with the destination DST_OFS
+   and the source SRC_OFS bytes into pages A and B. */
+static void
+bench (unsigned char *a, unsigned char *b, size_t dst_ofs, size_t src_ofs,
+       size_t size)
+{
+  unsigned char *dst = a + dst_ofs, *src = b + src_ofs;
+  uint64_t t0, t1, t2, old_cycles, new_cycles;
+  int i, old_cmp, new_cmp;
+
+  old_cycles = new_cycles = 0;
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      fill (b, PGSIZE, i);
+      t0 = rdtsc ();
+      old_memcpy (dst, src, size);
+      t1 = rdtsc ();
+      if (memcmp (dst, src, size))
+        fail ("old memcpy() disagrees with memcmp()");
+      memset (dst, 0, size);
+      t2 = rdtsc ();
+      memcpy (dst, src, size);
+      new_cycles += rdtsc () - t2;
+      old_cycles += t1 - t0;
+      if (old_memcmp (dst, src, size))
+        fail ("memcpy() did not copy %zu bytes", size);
+    }
+  report ("memcpy", size, old_cycles, new_cycles);
+
+  old_cycles = new_cycles = 0;
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      t0 = rdtsc ();
+      old_memset (dst, i, size);
+      t1 = rdtsc ();
+      memset (dst, i + 1, size);
+      t2 = rdtsc ();
+      old_cycles += t1 - t0;
+      new_cycles += t2 - t1;
+      if (size > 0 && (dst[0] != i + 1 || dst[size - 1] != i + 1))
+        fail ("memset() did not set %zu bytes", size);
+    }
+  report ("memset", size, old_cycles, new_cycles);
+
+  /* Compare equal blocks, the worst case. */
+  memcpy (dst, src, size);
+  old_cycles = new_cycles = 0;
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      t0 = rdtsc ();
+      old_cmp = old_memcmp (dst, src, size);
+      t1 = rdtsc ();
+      new_cmp = memcmp (dst, src, size);
+      t2 = rdtsc ();
+      old_cycles += t1 - t0;
+      new_cycles += t2 - t1;
+      if (old_cmp != 0 || new_cmp != 0)
+        fail ("memcmp() found a difference in equal blocks");
+    }
+  report ("memcmp", size, old_cycles, new_cycles);
+
+  /* Move overlapping blocks 3 bytes up, within A for the old
+     loop and within B for the new one. */
+  if (src_ofs + size + 3 > PGSIZE)
+    size = PGSIZE - src_ofs - 3;
+  old_cycles = new_cycles = 0;
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      fill (a, PGSIZE, i);
+      fill (b, PGSIZE, i);
+      t0 = rdtsc ();
+      old_memmove (a + src_ofs + 3, a + src_ofs, size);
+      t1 = rdtsc ();
+      memmove (src + 3, src, size);
+      t2 = rdtsc ();
+      old_cycles += t1 - t0;
+      new_cycles += t2 - t1;
+      if (old_memcmp (a, b, PGSIZE))
+        fail ("memmove() disagrees with the old memmove()");
+    }
+  report ("memmove", size, old_cycles, new_cycles);
+}
+
+void
+test_mem_bench (void)
+{
+  unsigned char *a = palloc_get_page (0);
+  unsigned char *b = palloc_get_page (0);
+
+  if (a == NULL || b == NULL)
+    fail ("out of pages");
+
+  bench (a, b, 0, 0, PGSIZE);
+  bench (a, b, 5, 3, 1000);
+  bench (a, b, 1, 2, 13);
+
+  palloc_free_page (a);
+  palloc_free_page (b);
+  pass ();
+}
@@ -0,0 +1,154 @@
+/* Inserts ELEM_CNT elements into an open-addressing hash table
+   and into a chained one, printing the most TSC cycles any one
+   insertion took in each; the chained table rehashes everything
+   at once when it grows, the open-addressing one a few slots at
+   a time.  Then deletes, reinserts and looks up elements at
+   random, checking every result against a separate record of
+   which elements are in the table. */
+
+#include <hash.h>
+#include <ohash.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "intrinsic.h"
+
+#define ELEM_CNT 20000
+#define OP_CNT 100000
+
+struct item
+  {
+    int key;
+    bool present;               /* In the ohash? */
+    struct ohash_elem oelem;
+    struct hash_elem helem;
+  };
+
+static uint64_t
+item_ohash (const struct ohash_elem *e, void *aux UNUSED)
+{
+  return hash_int (ohash_entry (e, struct item, oelem)->key);
+}
+
+static bool
+item_equal (const struct ohash_elem *a, const struct ohash_elem *b,
+            void *aux UNUSED)
+{
+  return (ohash_entry (a, struct item, oelem)->key
+          == ohash_entry (b, struct item, oelem)->key);
+}
+
+static bool
+item_match (const struct ohash_elem *e, const void *key, void *aux UNUSED)
+{
+  return ohash_entry (e, struct item, oelem)->key == *(const int *) key;
+}
+
+static uint64_t
+item_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct item, helem)->key);
+}
+
+static bool
+item_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  return (hash_entry (a, struct item, helem)->key
+          < hash_entry (b, struct item, helem)->key);
+}
+
+static size_t apply_cnt;
+
+static void
+count_item (struct ohash_elem *e, void *aux UNUSED)
+{
+  if (!ohash_entry (e, struct item, oelem)->present)
+    fail ("ohash_apply() visited a deleted element");
+  apply_cnt++;
+}
+
+void
+test_ohash_resize (void)
+{
+  struct item *items = malloc (ELEM_CNT * sizeof *items);
+  struct ohash oh;
+  struct hash h;
+  uint64_t max_ohash = 0, max_hash = 0;
+  size_t present_cnt = ELEM_CNT;
+  int i;
+
+  if (items == NULL)
+    fail ("out of memory");
+  ohash_init (&oh, item_ohash, item_equal, NULL);
+  if (!hash_init (&h, item_hash, item_less, NULL))
+    fail ("hash_init() failed");
+
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      uint64_t t0, t1, t2;
+
+      items[i].key = i * 7;
+      items[i].present = true;
+      t0 = rdtsc ();
+      if (ohash_insert (&oh, &items[i].oelem) != NULL)
+        fail ("ohash_insert() of key %d failed", items[i].key);
+      t1 = rdtsc ();
+      hash_insert (&h, &items[i].helem);
+      t2 = rdtsc ();
+      if (t1 - t0 > max_ohash)
+        max_ohash = t1 - t0;
+      if (t2 - t1 > max_hash)
+        max_hash = t2 - t1;
+    }
+  msg ("worst insertion of %d: ohash %llu cycles, hash %llu cycles",
+       ELEM_CNT, (unsigned long long) max_ohash,
+       (unsigned long long) max_hash);
+  hash_destroy (&h, NULL);
+
+  for (i = 0; i < OP_CNT; i++)
+    {
+      struct item *it = &items[random_ulong () % ELEM_CNT];
+      struct ohash_elem *e;
+
+      switch (random_ulong () % 3)
+        {
+        case 0:
+          e = ohash_insert (&oh, &it->oelem);
+          if (e != (it->present ? &it->oelem : NULL))
+            fail ("ohash_insert() of key %d went wrong", it->key);
+          if (!it->present)
+            present_cnt++;
+          it->present = true;
+          break;
+
+        case 1:
+          if (it->present)
+            {
+              ohash_remove (&oh, &it->oelem);
+              present_cnt--;
+            }
+          it->present = false;
+          break;
+
+        case 2:
+          e = ohash_find_key (&oh, hash_int (it->key), item_match, &it->key);
+          if (e != (it->present ? &it->oelem : NULL))
+            fail ("ohash_find_key() of key %d went wrong", it->key);
+          break;
+        }
+      if (ohash_size (&oh) != present_cnt)
+        fail ("ohash_size() is %zu, expected %zu",
+              ohash_size (&oh), present_cnt);
+    }
+
+  ohash_apply (&oh, count_item);
+  if (apply_cnt != present_cnt)
+    fail ("ohash_apply() visited %zu elements, expected %zu",
+          apply_cnt, present_cnt);
+
+  ohash_destroy (&oh, NULL);
+  free (items);
+  pass ();
+}
@@ -0,0 +1,147 @@
+/* Checks the buddy page allocator on the user pool, which
+   nothing else uses while the test runs.  A one-page allocation
+   must split the smallest free block, leaving one new free block
+   at each order below it, and freeing the page must merge them
+   back.  A block freed in two halves must merge with its own
+   buddy.  Blocks of several orders, and of sizes in between, must
+   be aligned to their order and must not overlap.  Freeing
+   neighbouring pages in any order must leave the free block
+   counts as they started. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* More orders than the allocator has; palloc_free_blocks()
+   returns 0 for the ones it does not have. */
+#define ORDER_CNT 32
+
+/* Pages freed in an interleaved order. */
+#define NEIGHBOR_CNT 16
+
+static void *pool_base;
+
+/* Stores the number of free blocks of each order in the user
+   pool into CNT. */
+static void
+snapshot (size_t cnt[ORDER_CNT])
+{
+  int order;
+
+  for (order = 0; order < ORDER_CNT; order++)
+    cnt[order] = palloc_free_blocks (PAL_USER, order);
+}
+
+/* Fails unless the user pool's free block counts equal EXPECT. */
+static void
+check_counts (const size_t expect[ORDER_CNT], const char *when)
+{
+  size_t cnt[ORDER_CNT];
+  int order;
+
+  snapshot (cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    if (cnt[order] != expect[order])
+      fail ("%s: %zu free blocks of order %d, expected %zu",
+            when, cnt[order], order, expect[order]);
+}
+
+/* Returns the smallest order whose block holds PAGE_CNT pages. */
+static int
+order_of (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Allocates PAGE_CNT pages from the user pool and fails unless
+   they start on a block boundary of their order. */
+static void *
+get_aligned (size_t page_cnt)
+{
+  uint8_t *p = palloc_get_multiple (PAL_USER, page_cnt);
+  size_t page_idx;
+
+  if (p == NULL)
+    fail ("palloc_get_multiple(%zu) failed", page_cnt);
+  page_idx = (p - (uint8_t *) pool_base) / PGSIZE;
+  if (page_idx % ((size_t) 1 << order_of (page_cnt)) != 0)
+    fail ("%zu pages at pool page %zu are not aligned to order %d",
+          page_cnt, page_idx, order_of (page_cnt));
+  return p;
+}
+
+void
+test_palloc_buddy (void)
+{
+  static const size_t sizes[] = { 1, 2, 3, 4, 5, 8, 13, 16, 32, 64, 100 };
+  enum { SIZE_CNT = sizeof sizes / sizeof *sizes };
+  size_t start[ORDER_CNT], expect[ORDER_CNT];
+  void *blocks[SIZE_CNT];
+  void *pages[NEIGHBOR_CNT];
+  size_t pool_pages, i, j;
+  uint8_t *p;
+  int order, smallest;
+
+  palloc_user_range (&pool_base, &pool_pages);
+  snapshot (start);
+
+  /* Split and merge back. */
+  for (smallest = 0; smallest < ORDER_CNT; smallest++)
+    if (start[smallest] > 0)
+      break;
+  if (smallest == ORDER_CNT)
+    fail ("user pool has no free pages");
+  p = get_aligned (1);
+  memcpy (expect, start, sizeof expect);
+  for (order = 0; order < smallest; order++)
+    expect[order]++;
+  expect[smallest]--;
+  check_counts (expect, "after a one-page allocation");
+  msg ("one-page allocation split the smallest free block");
+  palloc_free_page (p);
+  check_counts (start, "after freeing the page");
+  msg ("freeing the page merged the split blocks back");
+
+  /* A block freed in two halves. */
+  p = get_aligned (16);
+  snapshot (expect);
+  palloc_free_multiple (p, 8);
+  expect[3]++;
+  check_counts (expect, "after freeing the first half of a block");
+  palloc_free_multiple (p + 8 * PGSIZE, 8);
+  check_counts (start, "after freeing the second half of a block");
+  msg ("block freed in halves merged with its buddy");
+
+  /* Several orders and sizes in between. */
+  for (i = 0; i < SIZE_CNT; i++)
+    {
+      blocks[i] = get_aligned (sizes[i]);
+      memset (blocks[i], (int) i, sizes[i] * PGSIZE);
+    }
+  for (i = 0; i < SIZE_CNT; i++)
+    for (j = 0; j < sizes[i] * PGSIZE; j++)
+      if (((uint8_t *) blocks[i])[j] != i)
+        fail ("block of %zu pages overwritten at byte %zu", sizes[i], j);
+  msg ("blocks of several orders were aligned and disjoint");
+  for (i = 0; i < SIZE_CNT; i++)
+    palloc_free_multiple (blocks[i], sizes[i]);
+  check_counts (start, "after freeing blocks of several orders");
+  msg ("freeing them restored the free block counts");
+
+  /* Neighbouring pages, freed even ones first. */
+  for (i = 0; i < NEIGHBOR_CNT; i++)
+    pages[i] = get_aligned (1);
+  for (i = 0; i < NEIGHBOR_CNT; i += 2)
+    palloc_free_page (pages[i]);
+  for (i = 1; i < NEIGHBOR_CNT; i += 2)
+    palloc_free_page (pages[i]);
+  check_counts (start, "after freeing neighbouring pages");
+  msg ("neighbouring pages merged when freed out of order");
+  pass ();
+}
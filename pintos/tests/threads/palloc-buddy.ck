@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) one-page allocation split the smallest free block
+(palloc-buddy) freeing the page merged the split blocks back
+(palloc-buddy) block freed in halves merged with its buddy
+(palloc-buddy) blocks of several orders were aligned and disjoint
+(palloc-buddy) freeing them restored the free block counts
+(palloc-buddy) neighbouring pages merged when freed out of order
+(palloc-buddy) PASS
+(palloc-buddy) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Sleeps so that the idle thread can fill the reserve of zeroed
+   pages, then takes PAGE_CNT pages with PAL_ZERO, checking that
+   each is all zeros, and dirties and frees them.  Fails unless
+   some of those requests were served from the reserve.  Does it
+   again without sleeping, so that some requests miss the reserve.
+   Prints the page allocator statistics, including the reserve's
+   hit and miss counters. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 64
+
+static void *pages[PAGE_CNT];
+
+static void
+take_pages (void)
+{
+  size_t i, k;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      uint64_t *p = pages[i] = palloc_get_page (PAL_ZERO);
+      if (p == NULL)
+        fail ("palloc_get_page() %zu failed", i);
+      for (k = 0; k < PGSIZE / sizeof *p; k++)
+        if (p[k] != 0)
+          fail ("page %zu is not zeroed at word %zu", i, k);
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      memset (pages[i], 0xa5, PGSIZE);
+      palloc_free_page (pages[i]);
+    }
+}
+
+void
+test_palloc_zero (void)
+{
+  unsigned long long hits0, hits1, misses0, misses1;
+
+  timer_sleep (TIMER_FREQ / 10);
+  palloc_zero_stats (0, &hits0, &misses0);
+  take_pages ();
+  palloc_zero_stats (0, &hits1, &misses1);
+  if (hits1 == hits0)
+    fail ("no page came from the reserve after sleeping "
+          "(%llu misses)", misses1 - misses0);
+  msg ("first round after sleeping took pages from the reserve");
+
+  take_pages ();
+  palloc_print_stats ();
+  pass ();
+}
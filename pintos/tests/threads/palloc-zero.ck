@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "reserve of zeroed pages was not used after sleeping"
+  unless grep ($_ eq '(palloc-zero) first round after sleeping took pages '
+               . 'from the reserve', @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(palloc-zero) PASS', @output);
+
+pass;
@@ -0,0 +1,106 @@
+/* Inserts ELEM_CNT elements with random keys into a sorted list
+   with list_insert_ordered() and into a red-black tree, then
+   empties both by repeatedly removing the least element, as a
+   sleep or ready queue would.  Both must come out in the same
+   order.  Prints the TSC cycles for each, which depend on the
+   machine. */
+
+#include <list.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "intrinsic.h"
+
+#define ELEM_CNT 10000
+
+struct item
+  {
+    int key;
+    struct list_elem list_elem;
+    struct rb_elem rb_elem;
+  };
+
+static bool
+list_less (const struct list_elem *a, const struct list_elem *b,
+           void *aux UNUSED)
+{
+  return (list_entry (a, struct item, list_elem)->key
+          < list_entry (b, struct item, list_elem)->key);
+}
+
+static bool
+rb_less (const struct rb_elem *a, const struct rb_elem *b, void *aux UNUSED)
+{
+  return (rb_entry (a, struct item, rb_elem)->key
+          < rb_entry (b, struct item, rb_elem)->key);
+}
+
+static void
+report (const char *op, uint64_t list_cycles, uint64_t rb_cycles)
+{
+  msg ("%-14s list %12llu  rbtree %10llu cycles  (%llux)", op,
+       (unsigned long long) list_cycles, (unsigned long long) rb_cycles,
+       (unsigned long long) (rb_cycles ? list_cycles / rb_cycles : 0));
+}
+
+void
+test_rbtree_bench (void)
+{
+  struct item *items = malloc (ELEM_CNT * sizeof *items);
+  struct list list;
+  struct rbtree tree;
+  uint64_t t0, t1, t2;
+  int i;
+
+  if (items == NULL)
+    fail ("out of memory");
+  for (i = 0; i < ELEM_CNT; i++)
+    items[i].key = random_ulong () % (ELEM_CNT * 4);
+  list_init (&list);
+  rb_init (&tree, rb_less, NULL, NULL);
+
+  t0 = rdtsc ();
+  for (i = 0; i < ELEM_CNT; i++)
+    list_insert_ordered (&list, &items[i].list_elem, list_less, NULL);
+  t1 = rdtsc ();
+  for (i = 0; i < ELEM_CNT; i++)
+    rb_insert (&tree, &items[i].rb_elem);
+  t2 = rdtsc ();
+  report ("insert", t1 - t0, t2 - t1);
+
+  /* Remove the least element until empty.  Only the key order
+     must match, since equal keys may be in different orders. */
+  t0 = rdtsc ();
+  for (i = 0; i < ELEM_CNT; i++)
+    list_pop_front (&list);
+  t1 = rdtsc ();
+  for (i = 0; i < ELEM_CNT; i++)
+    rb_remove (&tree, rb_min (&tree));
+  t2 = rdtsc ();
+  report ("pop min", t1 - t0, t2 - t1);
+  if (!list_empty (&list) || !rb_empty (&tree))
+    fail ("containers not empty");
+
+  /* Check that both orders agree, outside the timed loops. */
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      list_insert_ordered (&list, &items[i].list_elem, list_less, NULL);
+      rb_insert (&tree, &items[i].rb_elem);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      struct item *a = list_entry (list_pop_front (&list),
+                                   struct item, list_elem);
+      struct item *b = rb_entry (rb_min (&tree), struct item, rb_elem);
+
+      if (a->key != b->key)
+        fail ("element %d: list has key %d, tree has key %d",
+              i, a->key, b->key);
+      rb_remove (&tree, &b->rb_elem);
+    }
+
+  free (items);
+  pass ();
+}
@@ -0,0 +1,206 @@
+/* Inserts, removes and updates elements of an augmented
+   red-black tree at random, keeping for each element the
+   greatest value in its subtree.  After every batch of
+   operations, checks the red-black properties, the augmented
+   maxima, the order seen by rb_next() and rb_prev(), and the
+   range that rb_lower_bound() and rb_upper_bound() return for a
+   random key.  Finally checks that equal keys stay in insertion
+   order. */
+
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+
+#define ELEM_CNT 1000
+#define KEY_CNT 200
+#define OP_CNT 20000
+#define BATCH 100
+
+struct item
+  {
+    int key;
+    int value;
+    int max;                    /* Greatest VALUE in the subtree. */
+    bool in_tree;
+    struct rb_elem elem;
+  };
+
+static struct item items[ELEM_CNT];
+
+static struct item *
+item_of (const struct rb_elem *e)
+{
+  return rb_entry (e, struct item, elem);
+}
+
+static bool
+item_less (const struct rb_elem *a, const struct rb_elem *b, void *aux UNUSED)
+{
+  return item_of (a)->key < item_of (b)->key;
+}
+
+/* Returns the greatest VALUE among E and its children's maxima. */
+static int
+subtree_max (const struct rb_elem *e)
+{
+  int max = item_of (e)->value;
+
+  if (e->left != NULL && item_of (e->left)->max > max)
+    max = item_of (e->left)->max;
+  if (e->right != NULL && item_of (e->right)->max > max)
+    max = item_of (e->right)->max;
+  return max;
+}
+
+static void
+item_augment (struct rb_elem *e, void *aux UNUSED)
+{
+  item_of (e)->max = subtree_max (e);
+}
+
+/* Checks the subtree rooted at E and returns its black height.
+   Adds the number of elements in it to *CNT. */
+static int
+check_subtree (const struct rb_elem *e, size_t *cnt)
+{
+  int left_height, right_height;
+
+  if (e == NULL)
+    return 1;
+  ++*cnt;
+  if ((e->left != NULL && e->left->parent != e)
+      || (e->right != NULL && e->right->parent != e))
+    fail ("bad parent pointer below key %d", item_of (e)->key);
+  if (e->red && ((e->left != NULL && e->left->red)
+                 || (e->right != NULL && e->right->red)))
+    fail ("red node with key %d has a red child", item_of (e)->key);
+  if (item_of (e)->max != subtree_max (e))
+    fail ("stale subtree maximum at key %d", item_of (e)->key);
+
+  left_height = check_subtree (e->left, cnt);
+  right_height = check_subtree (e->right, cnt);
+  if (left_height != right_height)
+    fail ("black heights %d and %d differ below key %d",
+          left_height, right_height, item_of (e)->key);
+  return left_height + !e->red;
+}
+
+static void
+check_tree (struct rbtree *tree, size_t in_tree_cnt)
+{
+  struct item key;
+  struct rb_elem *e, *lo, *hi;
+  size_t cnt = 0, eq_cnt, range_cnt;
+  int prev_key;
+  int i;
+
+  if (tree->root != NULL && tree->root->red)
+    fail ("root is red");
+  check_subtree (tree->root, &cnt);
+  if (cnt != in_tree_cnt || rb_size (tree) != in_tree_cnt)
+    fail ("tree has %zu elements, rb_size() says %zu, expected %zu",
+          cnt, rb_size (tree), in_tree_cnt);
+
+  /* In-order walks, both ways. */
+  cnt = 0;
+  prev_key = -1;
+  for (e = rb_min (tree); e != NULL; e = rb_next (e), cnt++)
+    {
+      if (item_of (e)->key < prev_key)
+        fail ("rb_next() went from key %d to %d", prev_key, item_of (e)->key);
+      prev_key = item_of (e)->key;
+    }
+  for (e = rb_max (tree); e != NULL; e = rb_prev (e))
+    cnt--;
+  if (cnt != 0)
+    fail ("forward and backward walks disagree");
+
+  /* The range [lower_bound, upper_bound) holds exactly the
+     elements equal to a random key. */
+  key.key = random_ulong () % KEY_CNT;
+  eq_cnt = 0;
+  for (i = 0; i < ELEM_CNT; i++)
+    if (items[i].in_tree && items[i].key == key.key)
+      eq_cnt++;
+  lo = rb_lower_bound (tree, &key.elem);
+  hi = rb_upper_bound (tree, &key.elem);
+  range_cnt = 0;
+  for (e = lo; e != hi; e = rb_next (e), range_cnt++)
+    if (item_of (e)->key != key.key)
+      fail ("range for key %d holds key %d", key.key, item_of (e)->key);
+  if (range_cnt != eq_cnt)
+    fail ("range for key %d holds %zu elements, expected %zu",
+          key.key, range_cnt, eq_cnt);
+  if (lo != NULL && rb_prev (lo) != NULL
+      && item_of (rb_prev (lo))->key >= key.key)
+    fail ("rb_lower_bound() is not the first element >= %d", key.key);
+  if ((rb_find (tree, &key.elem) != NULL) != (eq_cnt > 0))
+    fail ("rb_find() disagrees about key %d", key.key);
+}
+
+void
+test_rbtree_ops (void)
+{
+  struct rbtree tree;
+  size_t in_tree_cnt = 0;
+  int last_value[3];
+  struct rb_elem *e;
+  int i;
+
+  rb_init (&tree, item_less, item_augment, NULL);
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      items[i].key = random_ulong () % KEY_CNT;
+      items[i].value = random_ulong () % 100000;
+      items[i].in_tree = false;
+    }
+
+  for (i = 0; i < OP_CNT; i++)
+    {
+      struct item *it = &items[random_ulong () % ELEM_CNT];
+
+      if (!it->in_tree)
+        {
+          rb_insert (&tree, &it->elem);
+          it->in_tree = true;
+          in_tree_cnt++;
+        }
+      else if (random_ulong () % 3 != 0)
+        {
+          rb_remove (&tree, &it->elem);
+          it->in_tree = false;
+          in_tree_cnt--;
+        }
+      else
+        {
+          it->value = random_ulong () % 100000;
+          rb_augment_update (&tree, &it->elem);
+        }
+      if (i % BATCH == 0)
+        check_tree (&tree, in_tree_cnt);
+    }
+  check_tree (&tree, in_tree_cnt);
+  msg ("%d operations, %zu elements left", OP_CNT, in_tree_cnt);
+
+  /* Equal keys keep insertion order. */
+  rb_init (&tree, item_less, NULL, NULL);
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      items[i].key = i % 3;
+      items[i].value = i;
+      rb_insert (&tree, &items[i].elem);
+    }
+  last_value[0] = last_value[1] = last_value[2] = -1;
+  for (e = rb_min (&tree); e != NULL; e = rb_next (e))
+    {
+      struct item *it = item_of (e);
+      if (it->value < last_value[it->key])
+        fail ("equal keys out of insertion order");
+      last_value[it->key] = it->value;
+    }
+  while (!rb_empty (&tree))
+    rb_remove (&tree, tree.root);
+
+  pass ();
+}
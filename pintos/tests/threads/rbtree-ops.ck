@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(rbtree-ops) PASS', @output);
+fail "missing operation count in output"
+  unless grep (/^\(rbtree-ops\) 20000 operations, \d+ elements left$/,
+	       @output);
+
+pass;
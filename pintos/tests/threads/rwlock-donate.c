@@ -0,0 +1,83 @@
+/* The main thread and a "reader" thread both hold a
+   writer-preferring rwlock for reading.  A higher-priority
+   writer then blocks on it and donates its priority to both
+   readers, and a "late reader" queues up behind the writer
+   instead of joining the readers.  As the readers release the
+   lock, the writer gets it first, then the late reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static struct rwlock rwlock;
+static struct semaphore hold;
+
+static thread_func reader_func;
+static thread_func writer_func;
+static thread_func late_reader_func;
+
+void
+test_rwlock_donate (void)
+{
+  struct rwlock_read_hold rh;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock, true);
+  sema_init (&hold, 0);
+
+  rwlock_acquire_read (&rwlock, &rh);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_func, NULL);
+  thread_create ("writer", PRI_DEFAULT + 5, writer_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+
+  thread_create ("late reader", PRI_DEFAULT + 3, late_reader_func, NULL);
+  rwlock_release_read (&rwlock, &rh);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+
+  sema_up (&hold);
+  msg ("Main thread finished.");
+}
+
+static void
+reader_func (void *aux UNUSED)
+{
+  struct rwlock_read_hold rh;
+
+  rwlock_acquire_read (&rwlock, &rh);
+  msg ("Reader acquired the lock for reading.");
+  sema_down (&hold);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  rwlock_release_read (&rwlock, &rh);
+  msg ("Reader finished.");
+}
+
+static void
+writer_func (void *aux UNUSED)
+{
+  rwlock_acquire_write (&rwlock);
+  msg ("Writer acquired the lock for writing.");
+  rwlock_release_write (&rwlock);
+  msg ("Writer finished.");
+}
+
+static void
+late_reader_func (void *aux UNUSED)
+{
+  struct rwlock_read_hold rh;
+
+  msg ("Late reader should wait behind the writer.");
+  rwlock_acquire_read (&rwlock, &rh);
+  msg ("Late reader acquired the lock for reading.");
+  rwlock_release_read (&rwlock, &rh);
+  msg ("Late reader finished.");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) Reader acquired the lock for reading.
+(rwlock-donate) Main thread should have priority 36.  Actual priority: 36.
+(rwlock-donate) Late reader should wait behind the writer.
+(rwlock-donate) Main thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) Reader should have priority 36.  Actual priority: 36.
+(rwlock-donate) Writer acquired the lock for writing.
+(rwlock-donate) Writer finished.
+(rwlock-donate) Late reader acquired the lock for reading.
+(rwlock-donate) Late reader finished.
+(rwlock-donate) Reader finished.
+(rwlock-donate) Main thread finished.
+(rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,85 @@
+/* Checks the scheduling latency tracer.  Several threads at a
+   higher priority than the main thread sleep and wake a number of
+   times; afterward, each wakeup must show up in the wake-to-run
+   histogram, and each sleeper must have been charged at least one
+   block per sleep. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 5
+#define SLEEP_CNT 10
+
+struct sleeper
+  {
+    struct semaphore *done;     /* Upped when finished. */
+    struct sched_stats stats;   /* Statistics just before exit. */
+  };
+
+static thread_func sleeper_func;
+
+static uint64_t
+histogram_sum (void)
+{
+  uint64_t hist[SCHED_HIST_BUCKETS];
+  uint64_t sum = 0;
+  int i;
+
+  thread_sched_histogram (hist);
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+    sum += hist[i];
+  return sum;
+}
+
+void
+test_sched_latency (void)
+{
+  struct sleeper sleepers[THREAD_CNT];
+  struct semaphore done;
+  uint64_t before, after;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  before = histogram_sum ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      sleepers[i].done = &done;
+      thread_create (name, PRI_DEFAULT + 1, sleeper_func, &sleepers[i]);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  after = histogram_sum ();
+
+  if (after - before < THREAD_CNT * SLEEP_CNT)
+    fail ("histogram grew by %d, expected at least %d",
+          (int) (after - before), THREAD_CNT * SLEEP_CNT);
+  msg ("histogram counted every wakeup.");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (sleepers[i].stats.leaves[SCHED_BLOCK] < SLEEP_CNT)
+      fail ("sleeper %d blocked %u times, expected at least %d", i,
+            sleepers[i].stats.leaves[SCHED_BLOCK], SLEEP_CNT);
+  msg ("every sleeper blocked at least %d times.", SLEEP_CNT);
+  pass ();
+}
+
+static void
+sleeper_func (void *sleeper_)
+{
+  struct sleeper *s = sleeper_;
+  int i;
+
+  for (i = 0; i < SLEEP_CNT; i++)
+    timer_sleep (1);
+  thread_sched_stats (&s->stats);
+  sema_up (s->done);
+}
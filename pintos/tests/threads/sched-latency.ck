@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-latency) begin
+(sched-latency) histogram counted every wakeup.
+(sched-latency) every sleeper blocked at least 10 times.
+(sched-latency) PASS
+(sched-latency) end
+EOF
+pass;
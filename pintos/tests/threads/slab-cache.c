@@ -0,0 +1,102 @@
+/* Allocates many objects from a slab cache with a constructor,
+   checks that they do not overlap and that each comes back in
+   its constructed state, frees them in a scrambled order, does
+   it again to reuse the freed objects, and destroys the cache. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 1000
+#define OBJ_SIZE 100
+#define OBJ_MAGIC 0x0b1ec7
+
+struct object
+  {
+    int magic;                  /* OBJ_MAGIC while constructed. */
+    int owner;                  /* Index of the allocation, or -1. */
+    char pad[OBJ_SIZE - 2 * sizeof (int)];
+  };
+
+static int ctor_cnt;
+
+static void
+object_ctor (void *obj_)
+{
+  struct object *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  obj->owner = -1;
+  ctor_cnt++;
+}
+
+static void
+fill (struct kmem_cache *cache, struct object **objs)
+{
+  int i;
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if (objs[i]->magic != OBJ_MAGIC || objs[i]->owner != -1)
+        fail ("object %d is not in its constructed state", i);
+      objs[i]->owner = i;
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    if (objs[i]->owner != i)
+      fail ("object %d was overwritten by object %d", i, objs[i]->owner);
+}
+
+static void
+drain (struct kmem_cache *cache, struct object **objs)
+{
+  int i;
+
+  /* Shuffle, then free in that order. */
+  for (i = OBJ_CNT - 1; i > 0; i--)
+    {
+      int j = random_ulong () % (i + 1);
+      struct object *t = objs[i];
+      objs[i] = objs[j];
+      objs[j] = t;
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i]->owner = -1;
+      kmem_cache_free (cache, objs[i]);
+    }
+}
+
+void
+test_slab_cache (void)
+{
+  struct object **objs = malloc (OBJ_CNT * sizeof *objs);
+  struct kmem_cache *cache;
+  int first_ctor_cnt;
+
+  if (objs == NULL)
+    fail ("out of memory");
+  cache = kmem_cache_create ("test", sizeof (struct object), object_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create() failed");
+
+  fill (cache, objs);
+  drain (cache, objs);
+  first_ctor_cnt = ctor_cnt;
+  msg ("Constructed %d objects for %d allocations.", first_ctor_cnt, OBJ_CNT);
+
+  fill (cache, objs);
+  drain (cache, objs);
+  msg ("Constructed %d more objects for %d more allocations.",
+       ctor_cnt - first_ctor_cnt, OBJ_CNT);
+
+  kmem_print_stats ();
+  kmem_cache_destroy (cache);
+  free (objs);
+  pass ();
+}
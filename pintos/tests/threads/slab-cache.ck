@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(slab-cache) PASS', @output);
+
+# The cache keeps an empty slab, so the second round reuses some
+# objects without constructing them again.
+my ($first) = map (/^\(slab-cache\) Constructed (\d+) objects/, @output);
+my ($more) = map (/^\(slab-cache\) Constructed (\d+) more objects/, @output);
+fail "missing constructor counts in output"
+  unless defined $first && defined $more;
+fail "constructed $more objects again for reused allocations"
+  unless $more < $first;
+
+pass;
@@ -0,0 +1,51 @@
+/* Measures thread_create() + exit throughput.
+
+   Each iteration creates a short-lived child at a higher priority,
+   which runs immediately, signals the parent and exits, so that
+   the parent effectively joins every child before creating the
+   next one.  Prints the elapsed time, which depends on the
+   machine, and the thread page cache counters. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPAWN_CNT 10000
+
+static thread_func child_func;
+
+void
+test_spawn_bench (void)
+{
+  struct semaphore done;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (i = 0; i < SPAWN_CNT; i++)
+    {
+      if (thread_create ("child", PRI_DEFAULT + 1, child_func, &done)
+          == TID_ERROR)
+        fail ("thread_create() failed at iteration %d", i);
+      sema_down (&done);
+    }
+  msg ("%d spawn/join pairs in %lld ticks.", SPAWN_CNT,
+       (long long) timer_elapsed (start));
+  thread_print_stats ();
+  pass ();
+}
+
+static void
+child_func (void *done_)
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
@@ -0,0 +1,137 @@
+/* Compares strlen(), strchr(), memchr() and strcmp() against the
+   byte-at-a-time loops they replaced, on 1000-byte strings.  Each
+   pair must agree.  strcmp() compares equal strings, once with
+   the second one misaligned.  Prints the TSC cycles for each,
+   which depend on the machine. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "intrinsic.h"
+
+#define LEN 1000
+
+static char a[LEN + 1], b[LEN + 1], shifted[LEN + 2];
+
+/* The replaced implementations. */
+
+static size_t
+old_strlen (const char *string)
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
+
+static char *
+old_strchr (const char *string, int c_)
+{
+  char c = c_;
+
+  for (;;)
+    if (*string == c)
+      return (char *) string;
+    else if (*string == '\0')
+      return NULL;
+    else
+      string++;
+}
+
+static void *
+old_memchr (const void *block_, int ch_, size_t size)
+{
+  const unsigned char *block = block_;
+  unsigned char ch = ch_;
+
+  for (; size-- > 0; block++)
+    if (*block == ch)
+      return (void *) block;
+  return NULL;
+}
+
+static int
+old_strcmp (const char *a_, const char *b_)
+{
+  const unsigned char *a = (const unsigned char *) a_;
+  const unsigned char *b = (const unsigned char *) b_;
+
+  while (*a != '\0' && *a == *b)
+    {
+      a++;
+      b++;
+    }
+  return *a < *b ? -1 : *a > *b;
+}
+
+static void
+report (const char *op, uint64_t old_cycles, uint64_t new_cycles)
+{
+  msg ("%-8s old %8llu  new %6llu cycles  (%llux)", op,
+       (unsigned long long) old_cycles, (unsigned long long) new_cycles,
+       (unsigned long long) (new_cycles ? old_cycles / new_cycles : 0));
+}
+
+void
+test_string_bench (void)
+{
+  uint64_t t0, t1, t2;
+  size_t old_len, new_len;
+  char *old_p, *new_p;
+  int old_cmp, new_cmp;
+  int i;
+
+  for (i = 0; i < LEN; i++)
+    a[i] = b[i] = shifted[i + 1] = 'a' + i % 26;
+
+  t0 = rdtsc ();
+  old_len = old_strlen (a);
+  t1 = rdtsc ();
+  new_len = strlen (a);
+  t2 = rdtsc ();
+  if (old_len != LEN || new_len != LEN)
+    fail ("strlen() returned %zu (old) and %zu (new), expected %d",
+          old_len, new_len, LEN);
+  report ("strlen", t1 - t0, t2 - t1);
+
+  /* Search for a byte that is not there. */
+  t0 = rdtsc ();
+  old_p = old_strchr (a, '!');
+  t1 = rdtsc ();
+  new_p = strchr (a, '!');
+  t2 = rdtsc ();
+  if (old_p != NULL || new_p != NULL)
+    fail ("strchr() found a byte that is not in the string");
+  report ("strchr", t1 - t0, t2 - t1);
+
+  t0 = rdtsc ();
+  old_p = old_memchr (a, '!', LEN);
+  t1 = rdtsc ();
+  new_p = memchr (a, '!', LEN);
+  t2 = rdtsc ();
+  if (old_p != NULL || new_p != NULL)
+    fail ("memchr() found a byte that is not in the block");
+  report ("memchr", t1 - t0, t2 - t1);
+
+  /* Compare equal strings, the second one misaligned. */
+  t0 = rdtsc ();
+  old_cmp = old_strcmp (a, shifted + 1);
+  t1 = rdtsc ();
+  new_cmp = strcmp (a, shifted + 1);
+  t2 = rdtsc ();
+  if (old_cmp != 0 || new_cmp != 0)
+    fail ("strcmp() of equal strings returned %d", new_cmp);
+  report ("strcmp+1", t1 - t0, t2 - t1);
+
+  t0 = rdtsc ();
+  old_cmp = old_strcmp (a, b);
+  t1 = rdtsc ();
+  new_cmp = strcmp (a, b);
+  t2 = rdtsc ();
+  if (old_cmp != 0 || new_cmp != 0)
+    fail ("strcmp() of equal strings returned %d", new_cmp);
+  report ("strcmp", t1 - t0, t2 - t1);
+
+  pass ();
+}
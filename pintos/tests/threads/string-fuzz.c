@@ -0,0 +1,146 @@
+/* Checks strlen(), strnlen(), strchr(), memchr(), strcmp() and
+   strlcpy() against byte-at-a-time reference versions on random
+   strings of random lengths and alignments, half of them ending
+   at the last byte of a page. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define ITER_CNT 20000
+#define MAX_LEN 600
+
+static size_t
+ref_strlen (const char *s)
+{
+  size_t n = 0;
+
+  while (s[n] != '\0')
+    n++;
+  return n;
+}
+
+static const char *
+ref_memchr (const char *s, char c, size_t n)
+{
+  for (; n > 0; n--, s++)
+    if (*s == c)
+      return s;
+  return NULL;
+}
+
+static const char *
+ref_strchr (const char *s, char c)
+{
+  for (;; s++)
+    if (*s == c)
+      return s;
+    else if (*s == '\0')
+      return NULL;
+}
+
+static int
+ref_strcmp (const char *a_, const char *b_)
+{
+  const unsigned char *a = (const unsigned char *) a_;
+  const unsigned char *b = (const unsigned char *) b_;
+
+  while (*a != '\0' && *a == *b)
+    {
+      a++;
+      b++;
+    }
+  return *a < *b ? -1 : *a > *b;
+}
+
+static int
+sign (int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+/* Returns a random nonnull byte, usually from a small alphabet
+   so that searches and comparisons often match. */
+static char
+random_char (void)
+{
+  return random_ulong () % 2 ? 'a' + random_ulong () % 3
+                             : 1 + random_ulong () % 255;
+}
+
+/* Places a random string of LEN bytes in PAGE, either ending at
+   the end of the page or at a random offset, and returns it. */
+static char *
+random_string (char *page, size_t len)
+{
+  char *s;
+  size_t i;
+
+  if (random_ulong () % 2)
+    s = page + PGSIZE - len - 1;
+  else
+    s = page + random_ulong () % (PGSIZE - len);
+  for (i = 0; i < len; i++)
+    s[i] = random_char ();
+  s[len] = '\0';
+  return s;
+}
+
+void
+test_string_fuzz (void)
+{
+  char *a_page = palloc_get_page (0);
+  char *b_page = palloc_get_page (0);
+  char dst[MAX_LEN + 1];
+  int iter;
+
+  if (a_page == NULL || b_page == NULL)
+    fail ("out of pages");
+  random_init (0);
+
+  for (iter = 0; iter < ITER_CNT; iter++)
+    {
+      size_t len = random_ulong () % (random_ulong () % 4 ? 40 : MAX_LEN);
+      char *a = random_string (a_page, len);
+      char *b = b_page + random_ulong () % (PGSIZE - len);
+      size_t n = random_ulong () % (len + 2);
+      char c = random_ulong () % 5 ? random_char () : '\0';
+
+      if (strlen (a) != len)
+        fail ("strlen() of %zu-byte string returned %zu", len, strlen (a));
+      if (strnlen (a, n) != (len < n ? len : n))
+        fail ("strnlen(%zu) of %zu-byte string returned %zu",
+              n, len, strnlen (a, n));
+      if (strchr (a, c) != ref_strchr (a, c))
+        fail ("strchr() of %zu-byte string returned the wrong byte", len);
+      if (n > len)
+        n = len + 1;
+      if (memchr (a, c, n) != ref_memchr (a, c, n))
+        fail ("memchr() over %zu bytes returned the wrong byte", n);
+
+      /* Compare A with a copy, misaligned and maybe changed. */
+      memcpy (b, a, len + 1);
+      if (len > 0 && random_ulong () % 2)
+        b[random_ulong () % len] = random_char ();
+      if (random_ulong () % 4 == 0)
+        b[random_ulong () % (len + 1)] = '\0';
+      if (sign (strcmp (a, b)) != ref_strcmp (a, b)
+          || sign (strcmp (b, a)) != ref_strcmp (b, a))
+        fail ("strcmp() of %zu-byte strings disagrees", len);
+
+      n = random_ulong () % (MAX_LEN + 1);
+      memset (dst, 'x', sizeof dst);
+      if (strlcpy (dst, a, n) != len)
+        fail ("strlcpy() returned the wrong length");
+      if (n > 0 && (ref_strlen (dst) != (len < n - 1 ? len : n - 1)
+                    || memcmp (dst, a, ref_strlen (dst))))
+        fail ("strlcpy() into %zu bytes copied the wrong string", n);
+    }
+
+  palloc_free_page (a_page);
+  palloc_free_page (b_page);
+  pass ();
+}
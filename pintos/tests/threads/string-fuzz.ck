@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(string-fuzz) begin
+(string-fuzz) PASS
+(string-fuzz) end
+EOF
+pass;
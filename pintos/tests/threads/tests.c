@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-boundary", test_alarm_boundary},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -38,6 +39,21 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"spawn-bench", test_spawn_bench},
+    {"sched-latency", test_sched_latency},
+    {"rwlock-donate", test_rwlock_donate},
+    {"bitmap-bench", test_bitmap_bench},
+    {"slab-cache", test_slab_cache},
+    {"malloc-magazine", test_malloc_magazine},
+    {"malloc-medium", test_malloc_medium},
+    {"palloc-zero", test_palloc_zero},
+    {"palloc-buddy", test_palloc_buddy},
+    {"mem-bench", test_mem_bench},
+    {"string-fuzz", test_string_fuzz},
+    {"string-bench", test_string_bench},
+    {"ohash-resize", test_ohash_resize},
+    {"rbtree-ops", test_rbtree_ops},
+    {"rbtree-bench", test_rbtree_bench},
   };
 
 static const char *test_name;
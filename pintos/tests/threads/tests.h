@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_boundary;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -32,6 +33,21 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_spawn_bench;
+extern test_func test_sched_latency;
+extern test_func test_rwlock_donate;
+extern test_func test_bitmap_bench;
+extern test_func test_slab_cache;
+extern test_func test_malloc_magazine;
+extern test_func test_malloc_medium;
+extern test_func test_palloc_zero;
+extern test_func test_palloc_buddy;
+extern test_func test_mem_bench;
+extern test_func test_string_fuzz;
+extern test_func test_string_bench;
+extern test_func test_ohash_resize;
+extern test_func test_rbtree_ops;
+extern test_func test_rbtree_bench;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,122 @@
+#include "threads/lockstat.h"
+#ifdef LOCKSTAT
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+
+/* Number of distinct lock classes.  Locks initialized after the
+   table fills up are counted under "(other)". */
+#define LOCKSTAT_CLASS_MAX 64
+
+/* Number of classes shown by lockstat_print(). */
+#define LOCKSTAT_TOP_N 10
+
+static struct lockstat classes[LOCKSTAT_CLASS_MAX];
+static size_t class_cnt;
+
+/* Returns the statistics class for locks named NAME, creating it
+   if needed.  NAME must outlive the kernel, e.g. a string
+   literal; a null NAME selects the "(unnamed)" class. */
+struct lockstat *
+lockstat_lookup (const char *name) {
+	struct lockstat *ls = NULL;
+	enum intr_level old_level;
+	size_t i;
+
+	if (name == NULL)
+		name = "(unnamed)";
+
+	old_level = intr_disable ();
+	for (i = 0; i < class_cnt; i++)
+		if (!strcmp (classes[i].name, name)) {
+			ls = &classes[i];
+			break;
+		}
+	if (ls == NULL) {
+		/* The last slot is reserved for the overflow class. */
+		if (class_cnt < LOCKSTAT_CLASS_MAX - 1) {
+			ls = &classes[class_cnt++];
+			ls->name = name;
+		} else {
+			ls = &classes[LOCKSTAT_CLASS_MAX - 1];
+			ls->name = "(other)";
+			class_cnt = LOCKSTAT_CLASS_MAX;
+		}
+	}
+	intr_set_level (old_level);
+	return ls;
+}
+
+/* Records an acquisition of a lock in class LS after waiting
+   CYCLES.  CONTENDED is true if the lock was not free at the
+   first attempt. */
+void
+lockstat_record_wait (struct lockstat *ls, uint64_t cycles, bool contended) {
+	enum intr_level old_level = intr_disable ();
+
+	ls->acquired++;
+	if (contended) {
+		ls->contended++;
+		ls->wait_total += cycles;
+		if (cycles > ls->wait_max)
+			ls->wait_max = cycles;
+	}
+	intr_set_level (old_level);
+}
+
+/* Records that a lock in class LS was held for CYCLES. */
+void
+lockstat_record_hold (struct lockstat *ls, uint64_t cycles) {
+	enum intr_level old_level = intr_disable ();
+
+	ls->hold_total += cycles;
+	if (cycles > ls->hold_max)
+		ls->hold_max = cycles;
+	intr_set_level (old_level);
+}
+
+/* Records that a waiter on a lock in class LS raised the
+   holder's priority. */
+void
+lockstat_record_donation (struct lockstat *ls) {
+	enum intr_level old_level = intr_disable ();
+
+	ls->donations++;
+	intr_set_level (old_level);
+}
+
+/* Prints the LOCKSTAT_TOP_N classes with the most total wait
+   time. */
+void
+lockstat_print (void) {
+	struct lockstat *top[LOCKSTAT_CLASS_MAX];
+	size_t cnt = 0;
+	size_t i, j;
+
+	/* Insertion sort by wait_total, descending. */
+	for (i = 0; i < class_cnt; i++) {
+		struct lockstat *ls = &classes[i];
+
+		if (ls->acquired == 0)
+			continue;
+		for (j = cnt++; j > 0 && top[j - 1]->wait_total < ls->wait_total; j--)
+			top[j] = top[j - 1];
+		top[j] = ls;
+	}
+
+	printf ("Lockstat: %zu classes, top %d by wait cycles:\n",
+			class_cnt, LOCKSTAT_TOP_N);
+	printf ("  %-16s %10s %10s %8s %14s %12s %14s %12s\n",
+			"name", "acquired", "contended", "donated",
+			"wait", "wait max", "hold", "hold max");
+	for (i = 0; i < cnt && i < LOCKSTAT_TOP_N; i++) {
+		struct lockstat *ls = top[i];
+
+		printf ("  %-16s %10lld %10lld %8lld %14"PRIu64" %12"PRIu64
+				" %14"PRIu64" %12"PRIu64"\n",
+				ls->name, ls->acquired, ls->contended, ls->donations,
+				ls->wait_total, ls->wait_max, ls->hold_total, ls->hold_max);
+	}
+}
+#endif /* LOCKSTAT */
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -28,18 +29,72 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Blocks bigger than 1 kB would waste up to half of a one-page
+   arena, so above that the "medium" descriptors step by PGSIZE /
+   8 bytes instead of doubling, and give each arena as many pages
+   (up to MEDIUM_ARENA_PAGES) as waste the least space.  A medium
+   block may then lie in any page of its arena, so it carries a
+   struct block_hdr just before it that points to the arena.
+
+   We can't handle blocks bigger than the largest medium block
+   using this scheme.  We handle those by allocating contiguous
+   pages with the page allocator and sticking the allocation size
+   at the beginning of the allocated block's arena header.
+   realloc() grows such a "big" block in place if the pages after
+   it are free, and shrinks it in place by freeing its tail.
+
+   In front of the descriptors, each thread keeps a "magazine" of
+   up to MAG_SIZE (or MAG_BYTES worth of) free blocks per
+   descriptor, linked through the
+   blocks themselves.  malloc() pops a block from the running
+   thread's magazine and free() pushes one onto it, and since no
+   other thread touches the magazine, neither needs a lock.  Only
+   when the magazine is empty (or full) does the thread take the
+   descriptor's lock, to move half a magazine of blocks from (or
+   to) the descriptor's free list at once.  A block in a magazine still
+   counts as allocated in its arena, so its arena is not freed
+   until the magazine gives the block back.  thread_exit() calls
+   malloc_thread_exit() to give back all of a thread's blocks.
+
+   A thread that frees a little of every size class and then
+   blocks for a long time would otherwise keep up to MAG_BYTES
+   per descriptor out of use, so each thread also counts the bytes
+   in all of its magazines, and when that goes over
+   MAG_THREAD_BYTES it empties its magazines, biggest blocks
+   first, until it is back down to half of that. */
+
+/* Largest number of blocks a magazine holds. */
+#define MAG_SIZE 16
+
+/* Largest number of bytes a magazine holds. */
+#define MAG_BYTES (16 * 1024)
+
+/* Largest number of bytes all of a thread's magazines hold. */
+#define MAG_THREAD_BYTES (32 * 1024)
+
+/* Largest number of pages in a medium arena. */
+#define MEDIUM_ARENA_PAGES 4
+
+/* Alignment of medium blocks.  Small and big blocks all lie 8
+   bytes past a multiple of this (see malloc_init()), which is
+   how block_to_arena() tells them apart. */
+#define MEDIUM_ALIGN 16
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
+	size_t arena_pages;         /* Number of pages in an arena. */
+	size_t first_ofs;           /* Offset of first block in an arena. */
+	size_t slot_size;           /* Distance between blocks in an arena. */
+	size_t mag_size;            /* Blocks a magazine holds. */
 	struct lock lock;           /* Lock. */
+	size_t arena_cnt;           /* Number of arenas. */
+	size_t free_blocks;         /* Number of blocks in FREE_LIST. */
+#ifdef LOCKSTAT
+	char lock_name[16];         /* Lockstat class of LOCK. */
+#endif
 };
 
 /* Magic number for detecting arena corruption. */
@@ -52,38 +107,121 @@ struct arena {
 	size_t free_cnt;            /* Free blocks; pages in big block. */
 };
 
+/* Magic number for detecting medium block corruption. */
+#define BLOCK_MAGIC 0x6d656469
+
+/* Header in front of each medium block. */
+struct block_hdr {
+	struct arena *arena;        /* Arena that holds the block. */
+	unsigned magic;             /* Always set to BLOCK_MAGIC. */
+};
+
 /* Free block. */
 struct block {
-	struct list_elem free_elem; /* Free list element. */
+	union {
+		struct list_elem free_elem; /* Free list element. */
+		struct block *mag_next;     /* Next block in a magazine. */
+	};
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[MALLOC_CLASS_MAX]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big blocks, for malloc_print_stats().  Updated with interrupts
+   off. */
+static size_t big_cnt;          /* Number of big blocks. */
+static size_t big_pages;        /* Pages in big blocks. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct desc *size_to_desc (size_t);
+static void add_desc (size_t block_size, size_t arena_pages, size_t first_ofs,
+		size_t slot_size);
+static bool big_resize (struct arena *, size_t page_cnt);
+static bool mag_refill (struct desc *, struct malloc_magazine *);
+static void mag_flush (struct desc *, struct malloc_magazine *, size_t cnt);
+static void mag_trim (struct malloc_magazine *keep);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
 	size_t block_size;
 
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	/* Small and big blocks start sizeof (struct arena) bytes into
+	   a page, plus a multiple of a power of 2 of at least 16. */
+	ASSERT (sizeof (struct arena) % MEDIUM_ALIGN == MEDIUM_ALIGN / 2);
+	ASSERT (sizeof (struct block_hdr) % MEDIUM_ALIGN == 0);
+
+	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+		add_desc (block_size, 1, sizeof (struct arena), block_size);
+
+	for (block_size = PGSIZE * 3 / 8; block_size < PGSIZE * 7 / 8;
+			block_size += PGSIZE / 8) {
+		size_t first_ofs = ROUND_UP (sizeof (struct arena), MEDIUM_ALIGN)
+			+ sizeof (struct block_hdr);
+		size_t slot_size = block_size + sizeof (struct block_hdr);
+		size_t best_pages = 1, best_used = 0;
+		size_t pages;
+
+		/* Pick the arena size that wastes the smallest share. */
+		for (pages = 1; pages <= MEDIUM_ARENA_PAGES; pages++) {
+			size_t cnt = (pages * PGSIZE - first_ofs - block_size) / slot_size + 1;
+			size_t used = cnt * block_size * 1000 / (pages * PGSIZE);
+			if (used > best_used) {
+				best_pages = pages;
+				best_used = used;
+			}
+		}
+		add_desc (block_size, best_pages, first_ofs, slot_size);
 	}
 }
 
+/* Adds a descriptor for BLOCK_SIZE-byte blocks, SLOT_SIZE bytes
+   apart and starting FIRST_OFS bytes into ARENA_PAGES-page
+   arenas. */
+static void
+add_desc (size_t block_size, size_t arena_pages, size_t first_ofs,
+		size_t slot_size) {
+	struct desc *d = &descs[desc_cnt++];
+
+	ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+	d->block_size = block_size;
+	d->arena_pages = arena_pages;
+	d->first_ofs = first_ofs;
+	d->slot_size = slot_size;
+	ASSERT (first_ofs + block_size <= arena_pages * PGSIZE);
+	d->blocks_per_arena = (arena_pages * PGSIZE - first_ofs - block_size)
+		/ slot_size + 1;
+	d->mag_size = block_size * MAG_SIZE <= MAG_BYTES
+		? MAG_SIZE : MAG_BYTES / block_size;
+	list_init (&d->free_list);
+	d->arena_cnt = d->free_blocks = 0;
+#ifdef LOCKSTAT
+	snprintf (d->lock_name, sizeof d->lock_name, "malloc %zu", block_size);
+#endif
+	lock_init_named (&d->lock, d->lock_name);
+}
+
+/* Returns the smallest descriptor that satisfies a SIZE-byte
+   request, or a null pointer if SIZE needs a big block. */
+static struct desc *
+size_to_desc (size_t size) {
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++)
+		if (d->block_size >= size)
+			return d;
+	return NULL;
+}
+
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	struct thread *cur;
 	struct desc *d;
+	struct malloc_magazine *m;
 	struct block *b;
 	struct arena *a;
 
@@ -93,16 +231,20 @@ malloc (size_t size) {
 
 	/* Find the smallest descriptor that satisfies a SIZE-byte
 	   request. */
-	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
-			break;
-	if (d == descs + desc_cnt) {
+	d = size_to_desc (size);
+	if (d == NULL) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+		enum intr_level old_level;
+
 		a = palloc_get_multiple (0, page_cnt);
 		if (a == NULL)
 			return NULL;
+		old_level = intr_disable ();
+		big_cnt++;
+		big_pages += page_cnt;
+		intr_set_level (old_level);
 
 		/* Initialize the arena to indicate a big block of PAGE_CNT
 		   pages, and return it. */
@@ -112,34 +254,16 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
-
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
-	}
-
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
+	/* Take a block from our magazine, refilling it first if it
+	   is empty. */
+	cur = thread_current ();
+	m = &cur->malloc_mags[d - descs];
+	if (m->cnt == 0 && !mag_refill (d, m))
+		return NULL;
+	b = m->top;
+	m->top = b->mag_next;
+	m->cnt--;
+	cur->malloc_mag_bytes -= d->block_size;
 	return b;
 }
 
@@ -174,7 +298,9 @@ block_size (void *block) {
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+   moving it in the process.  A block that NEW_SIZE leaves in the
+   same descriptor does not move, nor does a big block that stays
+   big, if the pages after it are free or it shrinks.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
@@ -184,9 +310,21 @@ realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
+	} else if (old_block == NULL) {
+		return malloc (new_size);
 	} else {
-		void *new_block = malloc (new_size);
-		if (old_block != NULL && new_block != NULL) {
+		struct arena *a = block_to_arena (old_block);
+		struct desc *d = size_to_desc (new_size);
+		void *new_block;
+
+		/* Resize in place, if we can. */
+		if (a->desc != NULL ? d == a->desc
+				: d == NULL && big_resize (a, DIV_ROUND_UP (new_size + sizeof *a,
+						PGSIZE)))
+			return old_block;
+
+		new_block = malloc (new_size);
+		if (new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
 			memcpy (new_block, old_block, min_size);
@@ -196,6 +334,26 @@ realloc (void *old_block, size_t new_size) {
 	}
 }
 
+/* Resizes big block arena A to PAGE_CNT pages without moving it.
+   Returns true if successful, false if the pages after A are not
+   free. */
+static bool
+big_resize (struct arena *a, size_t page_cnt) {
+	enum intr_level old_level;
+
+	if (page_cnt < a->free_cnt)
+		palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+				a->free_cnt - page_cnt);
+	else if (!palloc_extend_multiple (a, a->free_cnt, page_cnt))
+		return false;
+
+	old_level = intr_disable ();
+	big_pages += page_cnt - a->free_cnt;
+	intr_set_level (old_level);
+	a->free_cnt = page_cnt;
+	return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
@@ -204,6 +362,8 @@ free (void *p) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
 		struct desc *d = a->desc;
+		struct thread *cur;
+		struct malloc_magazine *m;
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
@@ -213,36 +373,234 @@ free (void *p) {
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
-			}
-
-			lock_release (&d->lock);
+			/* Put the block in our magazine, first making room
+			   if it is full, then trim our magazines if they have
+			   grown too big in all. */
+			cur = thread_current ();
+			m = &cur->malloc_mags[d - descs];
+			if (m->cnt == d->mag_size)
+				mag_flush (d, m, d->mag_size / 2);
+			b->mag_next = m->top;
+			m->top = b;
+			m->cnt++;
+			cur->malloc_mag_bytes += d->block_size;
+			if (cur->malloc_mag_bytes > MAG_THREAD_BYTES)
+				mag_trim (NULL);
 		} else {
 			/* It's a big block.  Free its pages. */
+			enum intr_level old_level = intr_disable ();
+			big_cnt--;
+			big_pages -= a->free_cnt;
+			intr_set_level (old_level);
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Gives every block in the running thread's magazines back to
+   the descriptors.  Called by thread_exit(). */
+void
+malloc_thread_exit (void) {
+	struct malloc_magazine *mags = thread_current ()->malloc_mags;
+	size_t i;
+
+	for (i = 0; i < desc_cnt; i++)
+		if (mags[i].cnt > 0)
+			mag_flush (&descs[i], &mags[i], mags[i].cnt);
+}
+
+/* Moves up to half a magazine's worth of blocks from descriptor
+   D's free list into empty magazine M, creating a new arena if the free list
+   is empty, then trims the running thread's other magazines if
+   they now hold too much.  Returns false if memory is not
+   available. */
+static bool
+mag_refill (struct desc *d, struct malloc_magazine *m) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (m->cnt == 0);
+
+	lock_acquire (&d->lock);
+
+	/* If the free list is empty, create a new arena. */
+	if (list_empty (&d->free_list)) {
+		struct arena *a;
+		size_t i;
+
+		/* Allocate the arena's pages. */
+		a = palloc_get_multiple (0, d->arena_pages);
+		if (a == NULL) {
+			lock_release (&d->lock);
+			return false;
+		}
+
+		/* Initialize arena and add its blocks to the free list. */
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			if (d->slot_size != d->block_size) {
+				struct block_hdr *h = (struct block_hdr *) b - 1;
+				h->arena = a;
+				h->magic = BLOCK_MAGIC;
+			}
+			list_push_back (&d->free_list, &b->free_elem);
+		}
+		d->arena_cnt++;
+		d->free_blocks += d->blocks_per_arena;
+	}
+
+	/* Move blocks from the free list to the magazine. */
+	while (m->cnt < d->mag_size / 2 && !list_empty (&d->free_list)) {
+		struct block *b = list_entry (list_pop_front (&d->free_list),
+				struct block, free_elem);
+		block_to_arena (b)->free_cnt--;
+		d->free_blocks--;
+		b->mag_next = m->top;
+		m->top = b;
+		m->cnt++;
+	}
+
+	lock_release (&d->lock);
+
+	cur->malloc_mag_bytes += m->cnt * d->block_size;
+	if (cur->malloc_mag_bytes > MAG_THREAD_BYTES)
+		mag_trim (m);
+	return true;
+}
+
+/* Moves CNT blocks from magazine M back to descriptor D's free
+   list, freeing any arena that becomes entirely unused. */
+static void
+mag_flush (struct desc *d, struct malloc_magazine *m, size_t cnt) {
+	ASSERT (cnt <= m->cnt);
+
+	thread_current ()->malloc_mag_bytes -= cnt * d->block_size;
+	lock_acquire (&d->lock);
+	while (cnt-- > 0) {
+		struct block *b = m->top;
+		struct arena *a = block_to_arena (b);
+
+		m->top = b->mag_next;
+		m->cnt--;
+
+		/* Add block to free list. */
+		list_push_front (&d->free_list, &b->free_elem);
+		d->free_blocks++;
+
+		/* If the arena is now entirely unused, free it. */
+		if (++a->free_cnt >= d->blocks_per_arena) {
+			size_t i;
+
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			for (i = 0; i < d->blocks_per_arena; i++) {
+				struct block *b = arena_to_block (a, i);
+				list_remove (&b->free_elem);
+			}
+			d->arena_cnt--;
+			d->free_blocks -= d->blocks_per_arena;
+			a->magic = 0;
+			palloc_free_multiple (a, d->arena_pages);
+		}
+	}
+	lock_release (&d->lock);
+}
+
+/* Empties the running thread's magazines other than KEEP, the
+   one with the biggest blocks first, until they hold at most
+   MAG_THREAD_BYTES / 2 bytes in all. */
+static void
+mag_trim (struct malloc_magazine *keep) {
+	struct thread *cur = thread_current ();
+	size_t i = desc_cnt;
+
+	while (i-- > 0 && cur->malloc_mag_bytes > MAG_THREAD_BYTES / 2) {
+		struct malloc_magazine *m = &cur->malloc_mags[i];
+		if (m != keep && m->cnt > 0)
+			mag_flush (&descs[i], m, m->cnt);
+	}
+}
+
+/* Adds the number of blocks in each of thread T's magazines to
+   the corresponding element of CNTS, an array of size_t. */
+static void
+count_mag_blocks (struct thread *t, void *cnts_) {
+	size_t *cnts = cnts_;
+	size_t i;
+
+	for (i = 0; i < desc_cnt; i++)
+		cnts[i] += t->malloc_mags[i].cnt;
+}
+
+/* Prints each descriptor's arenas, how many of their blocks are
+   in use and how many are cached in threads' magazines, how much
+   of their memory is in blocks that are in use, and how many
+   pages the medium blocks in use would take as big blocks
+   instead. */
+void
+malloc_print_stats (void) {
+	size_t mag_cnts[MALLOC_CLASS_MAX] = { 0 };
+	size_t medium_cnt = 0, medium_pages = 0;
+	size_t big_cnt_now, big_pages_now;
+	enum intr_level old_level;
+	size_t i;
+
+	old_level = intr_disable ();
+	thread_foreach (count_mag_blocks, mag_cnts);
+	intr_set_level (old_level);
+
+	printf ("Malloc: block size, arena pages, blocks per arena, arenas, "
+			"blocks in use, blocks in magazines, "
+			"%% of arena memory in use:\n");
+	for (i = 0; i < desc_cnt; i++) {
+		struct desc *d = &descs[i];
+		size_t arena_cnt, in_use, bytes;
+
+		lock_acquire (&d->lock);
+		arena_cnt = d->arena_cnt;
+		in_use = arena_cnt * d->blocks_per_arena - d->free_blocks;
+		lock_release (&d->lock);
+
+		/* Blocks in magazines count as allocated in their arenas.
+		   The two counts are not taken at the same moment, so keep
+		   the difference from going below zero. */
+		in_use -= mag_cnts[i] < in_use ? mag_cnts[i] : in_use;
+		bytes = arena_cnt * d->arena_pages * PGSIZE;
+		printf ("  %5zu %2zu %4zu %6zu %7zu %7zu %3zu%%\n",
+				d->block_size, d->arena_pages, d->blocks_per_arena, arena_cnt,
+				in_use, mag_cnts[i],
+				bytes ? in_use * d->block_size * 100 / bytes : 0);
+		if (d->slot_size != d->block_size) {
+			medium_cnt += in_use;
+			medium_pages += arena_cnt * d->arena_pages;
+		}
+	}
+	/* Every medium block would fit in a one-page big block. */
+	printf ("  medium blocks: %zu in %zu pages, as big blocks %zu pages\n",
+			medium_cnt, medium_pages, medium_cnt);
+
+	old_level = intr_disable ();
+	big_cnt_now = big_cnt;
+	big_pages_now = big_pages;
+	intr_set_level (old_level);
+	printf ("  big blocks: %zu in %zu pages\n", big_cnt_now, big_pages_now);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a;
+
+	if (pg_ofs (b) % MEDIUM_ALIGN == 0) {
+		/* A medium block.  Its header points to its arena. */
+		struct block_hdr *h = (struct block_hdr *) b - 1;
+
+		ASSERT (h->magic == BLOCK_MAGIC);
+		a = h->arena;
+	} else
+		a = pg_round_down (b);
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,7 +608,8 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| ((uint8_t *) b - (uint8_t *) a - a->desc->first_ofs)
+			% a->desc->slot_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
@@ -263,6 +622,6 @@ arena_to_block (struct arena *a, size_t idx) {
 	ASSERT (a->magic == ARENA_MAGIC);
 	ASSERT (idx < a->desc->blocks_per_arena);
 	return (struct block *) ((uint8_t *) a
-			+ sizeof *a
-			+ idx * a->desc->block_size);
+			+ a->desc->first_ofs
+			+ idx * a->desc->slot_size);
 }
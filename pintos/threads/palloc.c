@@ -2,12 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -24,13 +26,67 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free memory is kept as
+   blocks of 2**ORDER pages, aligned to their size relative to
+   the pool base, on one free list per order.  The list element
+   lives in the first page of the free block itself.  Allocating
+   N pages takes a block of the smallest order that fits, splits
+   larger blocks as needed, and gives the unused tail back; freeing
+   merges each block with its buddy for as long as the buddy is
+   free too.  Both are O(log n) in the pool size.  Each pool is
+   protected by its own lock, which shows up in the lockstat
+   report under the pool's name.  Since taking it may sleep, the
+   page allocator must not be called with interrupts off, such as
+   from the scheduler.
+
+   Each pool also keeps a reserve of pages that are already
+   filled with zeros, so that a one-page PAL_ZERO request does not
+   have to clear its page.  The idle thread refills the reserve
+   through palloc_prezero(), one page at a time, once it falls
+   below ZERO_LOW pages and until it reaches ZERO_HIGH.  Pages in
+   the reserve are allocated as far as the buddy allocator is
+   concerned; if an allocation finds no free block, the reserve is
+   given back first.
+
+   The idle thread never takes a pool's lock, since it must not
+   sleep or be found holding a lock that another thread wants to
+   donate to.  It touches the reserve only with interrupts off
+   and while no other thread is inside the critical section, and
+   zeroes each page with interrupts on and nothing held. */
+
+/* Number of block orders.  The largest block is 2**(BUDDY_ORDERS
+   - 1) pages. */
+#define BUDDY_ORDERS 20
+
+/* Value of order_map[] for pages that do not start a free block. */
+#define NOT_FREE 0xff
+
+/* Watermarks for the reserve of zeroed pages. */
+#define ZERO_LOW 8
+#define ZERO_HIGH 32
+
+/* The reserve is not refilled from a pool with fewer free pages
+   than this. */
+#define ZERO_MIN_FREE (4 * ZERO_HIGH)
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *order_map;             /* Order of free block at each page. */
+	struct list free_lists[BUDDY_ORDERS]; /* Free blocks, by order. */
+	size_t free_cnt[BUDDY_ORDERS];  /* Number of blocks on each list. */
+
+	/* Reserve of zeroed pages. */
+	struct list zero_list;          /* Zeroed pages. */
+	size_t zero_cnt;                /* Number of pages in ZERO_LIST. */
+	bool zero_refill;               /* Refilling up to ZERO_HIGH? */
+	void *zero_pending;             /* Zeroed page not yet in ZERO_LIST. */
+	unsigned long long zero_hits;   /* PAL_ZERO requests served from it. */
+	unsigned long long zero_misses; /* PAL_ZERO requests zeroed in place. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,9 +95,19 @@ static struct pool kernel_pool, user_pool;
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
+init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end,
+		const char *name);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free_block (struct pool *, size_t page_idx, int order);
+static void buddy_reserve (struct pool *, size_t page_idx, size_t page_cnt);
+static void pool_print_stats (const char *name, struct pool *);
+static bool pool_prezero (struct pool *);
+static bool pool_lock_free (struct pool *);
+static void zero_push (struct pool *, void *page);
+static void zero_drain (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -159,7 +225,8 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 					}
 					// generate kernel pool
 					init_pool (&kernel_pool,
-							&free_start, region_start, start + rem * PGSIZE);
+							&free_start, region_start, start + rem * PGSIZE,
+							"kernel pool");
 					// Transition to the next state
 					if (rem == size_in_pg) {
 						rem = user_pages;
@@ -188,7 +255,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 	}
 
 	// generate the user pool
-	init_pool(&user_pool, &free_start, region_start, end);
+	init_pool(&user_pool, &free_start, region_start, end, "user pool");
 
 	// Iterate over the e820_entry. Setup the usable.
 	uint64_t usable_bound = (uint64_t) free_start;
@@ -223,12 +290,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -263,18 +330,38 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
 
+	if (page_cnt == 0)
+		return NULL;
+
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	void *pages = NULL;
+	bool zeroed = false;
+
+	if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zero_cnt > 0) {
+		/* Take an already zeroed page. */
+		pages = list_pop_front (&pool->zero_list);
+		if (--pool->zero_cnt < ZERO_LOW)
+			pool->zero_refill = true;
+		pool->zero_hits++;
+		zeroed = true;
+	} else {
+		size_t page_idx = buddy_alloc (pool, page_cnt);
+		if (page_idx == BITMAP_ERROR
+				&& (pool->zero_cnt > 0 || pool->zero_pending != NULL)) {
+			zero_drain (pool);
+			page_idx = buddy_alloc (pool, page_cnt);
+		}
+		if (page_idx != BITMAP_ERROR)
+			pages = pool->base + PGSIZE * page_idx;
+		if (flags & PAL_ZERO)
+			pool->zero_misses++;
+	}
 	lock_release (&pool->lock);
-	void *pages;
-
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if (zeroed)
+			memset (pages, 0, sizeof (struct list_elem));
+		else if (flags & PAL_ZERO)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
@@ -318,8 +405,45 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	lock_acquire (&pool->lock);
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_free (pool, page_idx, page_cnt);
+	lock_release (&pool->lock);
+}
+
+/* Tries to grow the PAGE_CNT pages starting at PAGES, which must
+   have been obtained with palloc_get_multiple(), to NEW_CNT pages
+   without moving them, by taking the pages that follow them.
+   Returns true if successful, false if any of those pages is in
+   use or past the end of the pool. */
+bool
+palloc_extend_multiple (void *pages, size_t page_cnt, size_t new_cnt) {
+	struct pool *pool;
+	size_t page_idx;
+	bool success = false;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (new_cnt >= page_cnt);
+	if (new_cnt == page_cnt)
+		return true;
+
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+	lock_acquire (&pool->lock);
+	if (page_idx + (new_cnt - page_cnt) <= bitmap_size (pool->used_map)
+			&& !bitmap_contains (pool->used_map, page_idx,
+				new_cnt - page_cnt, true)) {
+		buddy_reserve (pool, page_idx, new_cnt - page_cnt);
+		success = true;
+	}
+	lock_release (&pool->lock);
+	return success;
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +452,356 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END */
+/* Zeroes one page for the reserve of a pool that is being
+   refilled.  Returns true if it did, false if no pool needs a
+   page or can spare one.  Called by the idle thread, with
+   interrupts on. */
+bool
+palloc_prezero (void) {
+	return pool_prezero (&kernel_pool) || pool_prezero (&user_pool);
+}
+
+/* Stores the address of the first page of the user pool in
+   *BASE and the number of pages in it in *PAGE_CNT.  Every page
+   that palloc_get_page(PAL_USER) returns lies in that range. */
+void
+palloc_user_range (void **base, size_t *page_cnt) {
+	*base = user_pool.base;
+	*page_cnt = bitmap_size (user_pool.used_map);
+}
+
+/* Returns the number of free blocks of 2**ORDER pages in the
+   user pool if PAL_USER is set in FLAGS, otherwise in the kernel
+   pool.  Pages in the reserve of zeroed pages do not count as
+   free. */
+size_t
+palloc_free_blocks (enum palloc_flags flags, int order) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t cnt;
+
+	if (order < 0 || order >= BUDDY_ORDERS)
+		return 0;
+	lock_acquire (&pool->lock);
+	cnt = pool->free_cnt[order];
+	lock_release (&pool->lock);
+	return cnt;
+}
+
+/* Stores in *HITS the number of PAL_ZERO requests so far that
+   took a page from the reserve of zeroed pages, and in *MISSES
+   the number that had to zero their pages in place.  Counts the
+   user pool if PAL_USER is set in FLAGS, otherwise the kernel
+   pool. */
+void
+palloc_zero_stats (enum palloc_flags flags, unsigned long long *hits,
+		unsigned long long *misses) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+	lock_acquire (&pool->lock);
+	*hits = pool->zero_hits;
+	*misses = pool->zero_misses;
+	lock_release (&pool->lock);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	pool_print_stats ("Kernel pool", &kernel_pool);
+	pool_print_stats ("User pool", &user_pool);
+}
+
+/* Initializes pool P as starting at START and ending at END.
+   NAME names the pool's lock. */
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
+init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end,
+		const char *name UNUSED) {
   /* We'll put the pool's used_map at its base.
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t om_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	int order;
 
-	lock_init(&p->lock);
+	lock_init_named (&p->lock, name);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->order_map = (uint8_t *) *bm_base + bm_pages;
+	for (order = 0; order < BUDDY_ORDERS; order++) {
+		list_init (&p->free_lists[order]);
+		p->free_cnt[order] = 0;
+	}
+	list_init (&p->zero_list);
+	p->zero_cnt = 0;
+	p->zero_refill = true;
+	p->zero_pending = NULL;
+	p->zero_hits = p->zero_misses = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->order_map, NOT_FREE, pgcnt);
+
+	*bm_base += bm_pages + om_pages;
+}
+
+/* Returns the first page of the block at PAGE_IDX in POOL. */
+static inline struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx) {
+	return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
 
-	*bm_base += bm_pages;
+/* Returns the index of the first page of block ELEM in POOL. */
+static inline size_t
+block_idx (const struct pool *pool, const struct list_elem *elem) {
+	return ((const uint8_t *) elem - pool->base) / PGSIZE;
+}
+
+/* Removes the free block of ORDER at PAGE_IDX from POOL's free
+   lists. */
+static void
+buddy_unlink (struct pool *pool, size_t page_idx, int order) {
+	ASSERT (pool->order_map[page_idx] == order);
+
+	list_remove (block_elem (pool, page_idx));
+	pool->order_map[page_idx] = NOT_FREE;
+	pool->free_cnt[order]--;
+}
+
+/* Puts the block of ORDER at PAGE_IDX on POOL's free lists,
+   without merging. */
+static void
+buddy_link (struct pool *pool, size_t page_idx, int order) {
+	list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+	pool->order_map[page_idx] = order;
+	pool->free_cnt[order]++;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if no free block is
+   big enough.  POOL's lock must be held. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) {
+	int want = 0, order;
+	size_t page_idx;
+
+	while (want < BUDDY_ORDERS && ((size_t) 1 << want) < page_cnt)
+		want++;
+	for (order = want; order < BUDDY_ORDERS; order++)
+		if (!list_empty (&pool->free_lists[order]))
+			break;
+	if (order >= BUDDY_ORDERS)
+		return BITMAP_ERROR;
+
+	page_idx = block_idx (pool, list_front (&pool->free_lists[order]));
+	buddy_unlink (pool, page_idx, order);
+
+	/* Split down to the wanted order, freeing the upper halves. */
+	while (order > want) {
+		order--;
+		buddy_link (pool, page_idx + ((size_t) 1 << order), order);
+	}
+
+	ASSERT (!bitmap_contains (pool->used_map, page_idx, page_cnt, true));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+
+	/* Give back the pages past PAGE_CNT. */
+	if (page_cnt < ((size_t) 1 << want))
+		buddy_free (pool, page_idx + page_cnt,
+				((size_t) 1 << want) - page_cnt);
+	return page_idx;
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, which need not
+   form a buddy block, by splitting the range into the largest
+   aligned blocks it contains.  POOL's lock must be held,
+   except while the pools are being populated. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order + 1 < BUDDY_ORDERS
+				&& (page_idx & (((size_t) 1 << (order + 1)) - 1)) == 0
+				&& ((size_t) 1 << (order + 1)) <= page_cnt)
+			order++;
+		buddy_free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Frees the block of ORDER at PAGE_IDX in POOL, merging it with
+   its buddy as long as the buddy is also free. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order) {
+	size_t pool_pages = bitmap_size (pool->used_map);
+
+	while (order + 1 < BUDDY_ORDERS) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy >= pool_pages || pool->order_map[buddy] != order)
+			break;
+		buddy_unlink (pool, buddy, order);
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	buddy_link (pool, page_idx, order);
+}
+
+/* Allocates the PAGE_CNT pages at PAGE_IDX in POOL, which must
+   all be free.  Takes each free block that overlaps the range off
+   its free list and gives back the parts of it outside the range.
+   POOL's lock must be held. */
+static void
+buddy_reserve (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+	size_t i = page_idx;
+
+	while (i < end) {
+		size_t head = i, size;
+		int order;
+
+		/* Find the free block that contains page I. */
+		for (order = 0; order < BUDDY_ORDERS; order++) {
+			head = i & ~(((size_t) 1 << order) - 1);
+			if (pool->order_map[head] == order)
+				break;
+		}
+		ASSERT (order < BUDDY_ORDERS);
+		size = (size_t) 1 << order;
+
+		buddy_unlink (pool, head, order);
+		if (head < page_idx)
+			buddy_free (pool, head, page_idx - head);
+		if (head + size > end)
+			buddy_free (pool, end, head + size - end);
+		i = head + size;
+	}
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+}
+
+/* Zeroes one page for POOL's reserve, if it is being refilled
+   and POOL has ZERO_MIN_FREE pages to spare.  Returns true if it
+   did.  Runs in the idle thread, so it does not take POOL's lock
+   but gives up whenever another thread is inside the critical
+   section. */
+static bool
+pool_prezero (struct pool *pool) {
+	size_t free_pages = 0, page_idx = BITMAP_ERROR;
+	enum intr_level old_level;
+	void *page;
+	int order;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	old_level = intr_disable ();
+	if (pool_lock_free (pool)) {
+		/* A page zeroed last time while the lock was busy. */
+		if (pool->zero_pending != NULL) {
+			zero_push (pool, pool->zero_pending);
+			pool->zero_pending = NULL;
+		}
+		if (pool->zero_refill) {
+			for (order = 0; order < BUDDY_ORDERS; order++)
+				free_pages += pool->free_cnt[order] << order;
+			if (free_pages >= ZERO_MIN_FREE)
+				page_idx = buddy_alloc (pool, 1);
+		}
+	}
+	intr_set_level (old_level);
+	if (page_idx == BITMAP_ERROR)
+		return false;
+
+	/* Zero the page with interrupts on, so that a thread that
+	   wakes up in the meantime preempts us and can allocate. */
+	page = pool->base + PGSIZE * page_idx;
+	memset (page, 0, PGSIZE);
+
+	/* The page is ours now.  If a thread entered the critical
+	   section while we were zeroing, park the page until the next
+	   call rather than wait for it. */
+	old_level = intr_disable ();
+	if (pool_lock_free (pool))
+		zero_push (pool, page);
+	else
+		pool->zero_pending = page;
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Returns true if no thread holds POOL's lock or is between
+   taking its semaphore and recording itself as the holder.
+   Interrupts must be off, so that none can enter until they are
+   turned back on. */
+static bool
+pool_lock_free (struct pool *pool) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	return pool->lock.semaphore.value > 0;
+}
+
+/* Adds zeroed PAGE to POOL's reserve.  POOL's lock must be held,
+   or interrupts off with pool_lock_free(POOL) true. */
+static void
+zero_push (struct pool *pool, void *page) {
+	list_push_front (&pool->zero_list, page);
+	if (++pool->zero_cnt >= ZERO_HIGH)
+		pool->zero_refill = false;
+}
+
+/* Gives every page in POOL's reserve of zeroed pages back to the
+   buddy allocator, and has the idle thread build the reserve up
+   again once POOL can spare the pages.  POOL's lock must be
+   held. */
+static void
+zero_drain (struct pool *pool) {
+	while (!list_empty (&pool->zero_list)) {
+		struct list_elem *e = list_pop_front (&pool->zero_list);
+		buddy_free (pool, block_idx (pool, e), 1);
+	}
+	if (pool->zero_pending != NULL) {
+		buddy_free (pool, block_idx (pool, pool->zero_pending), 1);
+		pool->zero_pending = NULL;
+	}
+	pool->zero_cnt = 0;
+	pool->zero_refill = true;
+}
+
+/* Prints the free block counts of POOL, named NAME, by order.
+   External fragmentation is the share of free pages that lie
+   outside the largest free block. */
+static void
+pool_print_stats (const char *name, struct pool *pool) {
+	size_t free_cnt[BUDDY_ORDERS];
+	size_t free_pages = 0, largest = 0, zero_cnt;
+	unsigned long long zero_hits, zero_misses;
+	int order;
+
+	/* Take a snapshot, so as not to hold up allocations while printing. */
+	lock_acquire (&pool->lock);
+	memcpy (free_cnt, pool->free_cnt, sizeof free_cnt);
+	zero_cnt = pool->zero_cnt;
+	zero_hits = pool->zero_hits;
+	zero_misses = pool->zero_misses;
+	lock_release (&pool->lock);
+
+	for (order = 0; order < BUDDY_ORDERS; order++)
+		if (free_cnt[order] > 0) {
+			free_pages += free_cnt[order] << order;
+			largest = (size_t) 1 << order;
+		}
+	printf ("%s: %zu of %zu pages free, largest free block %zu pages, "
+			"%zu%% fragmented\n",
+			name, free_pages, bitmap_size (pool->used_map), largest,
+			free_pages ? 100 - largest * 100 / free_pages : 0);
+	printf ("  free blocks by order:");
+	for (order = 0; order < BUDDY_ORDERS; order++)
+		if (free_cnt[order] > 0)
+			printf (" %d:%zu", order, free_cnt[order]);
+	printf ("\n");
+	printf ("  zeroed pages: %zu in reserve, %llu hits, %llu misses\n",
+			zero_cnt, zero_hits, zero_misses);
 }
 
 /* Returns true if PAGE was allocated from POOL,
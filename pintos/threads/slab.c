@@ -0,0 +1,345 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator" (USENIX 1994).
+
+   A cache hands out objects of one exact size, so unlike malloc()
+   it does not round the size up to a power of two.  It carves the
+   objects out of slabs.  Each slab is one page holding a struct
+   slab header, then one free-list link per object, then the
+   objects themselves.  Because the free list lives in the header
+   rather than in the free objects, a free object keeps the state
+   its constructor gave it.
+
+   Each cache keeps its slabs on three lists: partial (some
+   objects allocated), full, and empty.  Allocation takes an
+   object from a partial slab, or else from an empty one, and
+   creates a new slab only if both lists are empty.  A cache
+   keeps at most KMEM_EMPTY_MAX empty slabs and returns the rest
+   to the page allocator.  Each cache has its own lock. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Objects are aligned to this many bytes. */
+#define SLAB_ALIGN 8
+
+/* Number of empty slabs a cache keeps around. */
+#define KMEM_EMPTY_MAX 1
+
+/* Free-list terminator. */
+#define FREE_END UINT16_MAX
+
+/* Object cache. */
+struct kmem_cache {
+	const char *name;           /* Name (for statistics). */
+	size_t obj_size;            /* Requested object size. */
+	size_t slot_size;           /* OBJ_SIZE rounded up to SLAB_ALIGN. */
+	size_t objs_per_slab;       /* Objects in each slab. */
+	size_t first_ofs;           /* Offset of the first object. */
+	kmem_ctor_func *ctor;       /* Constructor, or null. */
+	struct lock lock;           /* Protects everything below. */
+	struct list partial;        /* Slabs with some objects in use. */
+	struct list full;           /* Slabs with all objects in use. */
+	struct list empty;          /* Slabs with no objects in use. */
+	size_t slab_cnt;            /* Slabs on all three lists. */
+	size_t empty_cnt;           /* Slabs on EMPTY. */
+
+	/* Statistics. */
+	size_t in_use;              /* Objects allocated now. */
+	size_t peak_in_use;         /* Highest IN_USE so far. */
+	unsigned long long alloc_cnt;   /* Calls to kmem_cache_alloc(). */
+	unsigned long long free_cnt;    /* Calls to kmem_cache_free(). */
+	unsigned long long grow_cnt;    /* Slabs created. */
+	unsigned long long reap_cnt;    /* Slabs given back. */
+
+	struct list_elem elem;      /* Element in cache_list. */
+};
+
+/* Slab header, at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of the cache's lists. */
+	size_t in_use;              /* Objects allocated. */
+	uint16_t free;              /* First free object, or FREE_END. */
+	uint16_t next[];            /* Next free object after each object. */
+};
+
+/* All caches, for kmem_print_stats(). */
+static struct list cache_list;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_destroy (struct kmem_cache *, struct slab *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Returns the object numbered IDX in slab S of cache C. */
+static inline void *
+slab_obj (const struct kmem_cache *c, struct slab *s, size_t idx) {
+	return (uint8_t *) s + c->first_ofs + idx * c->slot_size;
+}
+
+/* Initializes the slab allocator. */
+void
+kmem_init (void) {
+	list_init (&cache_list);
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME,
+   which must outlive the cache.  If CTOR is non-null, it is run
+   on every object when the object's slab is created.  SIZE must
+   leave room for at least one object and its slab header in a
+   page.  Returns a null pointer if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor) {
+	struct kmem_cache *c;
+	enum intr_level old_level;
+	size_t n;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	c->name = name;
+	c->obj_size = size;
+	c->slot_size = ROUND_UP (size, SLAB_ALIGN);
+	c->ctor = ctor;
+
+	/* Fit as many objects as possible after the header and the
+	   free-list links. */
+	n = (PGSIZE - sizeof (struct slab)) / (c->slot_size + sizeof (uint16_t));
+	while (n > 0 && ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+				SLAB_ALIGN) + n * c->slot_size > PGSIZE)
+		n--;
+	ASSERT (n > 0 && n < FREE_END);
+	c->objs_per_slab = n;
+	c->first_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+			SLAB_ALIGN);
+
+	lock_init_named (&c->lock, name);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->slab_cnt = c->empty_cnt = 0;
+	c->in_use = c->peak_in_use = 0;
+	c->alloc_cnt = c->free_cnt = c->grow_cnt = c->reap_cnt = 0;
+
+	old_level = intr_disable ();
+	list_push_back (&cache_list, &c->elem);
+	intr_set_level (old_level);
+	return c;
+}
+
+/* Destroys cache C, which must have no objects allocated. */
+void
+kmem_cache_destroy (struct kmem_cache *c) {
+	enum intr_level old_level;
+
+	if (c == NULL)
+		return;
+
+	ASSERT (c->in_use == 0);
+	ASSERT (list_empty (&c->partial) && list_empty (&c->full));
+	while (!list_empty (&c->empty))
+		slab_destroy (c, list_entry (list_front (&c->empty),
+					struct slab, elem));
+
+	old_level = intr_disable ();
+	list_remove (&c->elem);
+	intr_set_level (old_level);
+	free (c);
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	ASSERT (c != NULL);
+
+	lock_acquire (&c->lock);
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else if (!list_empty (&c->empty)) {
+		s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+		c->empty_cnt--;
+		list_push_front (&c->partial, &s->elem);
+	} else {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	ASSERT (s->free != FREE_END);
+	obj = slab_obj (c, s, s->free);
+	s->free = s->next[s->free];
+	if (++s->in_use == c->objs_per_slab) {
+		list_remove (&s->elem);
+		list_push_front (&c->full, &s->elem);
+	}
+
+	c->alloc_cnt++;
+	if (++c->in_use > c->peak_in_use)
+		c->peak_in_use = c->in_use;
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Like kmem_cache_alloc(), but zeroes the object.  Not useful for
+   caches with a constructor. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c) {
+	void *obj = kmem_cache_alloc (c);
+
+	if (obj != NULL)
+		memset (obj, 0, c->obj_size);
+	return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  OBJ must be in its constructed state, if C has a
+   constructor. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (c, obj);
+	idx = ((uint8_t *) obj - (uint8_t *) slab_obj (c, s, 0)) / c->slot_size;
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->slot_size);
+#endif
+
+	lock_acquire (&c->lock);
+	ASSERT (s->in_use > 0);
+	s->next[idx] = s->free;
+	s->free = idx;
+	if (s->in_use-- == c->objs_per_slab) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	if (s->in_use == 0) {
+		list_remove (&s->elem);
+		if (c->empty_cnt < KMEM_EMPTY_MAX) {
+			list_push_front (&c->empty, &s->elem);
+			c->empty_cnt++;
+		} else {
+			c->slab_cnt--;
+			c->reap_cnt++;
+			s->magic = 0;
+			palloc_free_page (s);
+		}
+	}
+
+	c->free_cnt++;
+	c->in_use--;
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache. */
+void
+kmem_print_stats (void) {
+	struct list_elem *e;
+
+	printf ("Slab caches:\n");
+	for (e = list_begin (&cache_list); e != list_end (&cache_list);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t bytes;
+
+		lock_acquire (&c->lock);
+		bytes = c->slab_cnt * PGSIZE;
+		printf ("  %-12s %4zu-byte objects, %3zu/slab; %zu slabs "
+				"(%zu full, %zu partial, %zu empty)\n",
+				c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+				list_size (&c->full), list_size (&c->partial), c->empty_cnt);
+		printf ("  %-12s %zu in use (peak %zu), %llu allocs, %llu frees, "
+				"%llu slabs created, %llu freed, %zu%% of slab memory used\n",
+				"", c->in_use, c->peak_in_use, c->alloc_cnt, c->free_cnt,
+				c->grow_cnt, c->reap_cnt,
+				bytes ? c->in_use * c->obj_size * 100 / bytes : 0);
+		lock_release (&c->lock);
+	}
+}
+
+/* Allocates a new slab for cache C, whose lock must be held, and
+   runs the constructor on its objects.  Returns a null pointer
+   if memory is not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s;
+	size_t i;
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->in_use = 0;
+	s->free = 0;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : FREE_END;
+		if (c->ctor != NULL)
+			c->ctor (slab_obj (c, s, i));
+	}
+
+	c->slab_cnt++;
+	c->grow_cnt++;
+	return s;
+}
+
+/* Removes empty slab S from cache C and frees its page. */
+static void
+slab_destroy (struct kmem_cache *c, struct slab *s) {
+	ASSERT (s->in_use == 0);
+
+	list_remove (&s->elem);
+	c->empty_cnt--;
+	c->slab_cnt--;
+	c->reap_cnt++;
+	s->magic = 0;
+	palloc_free_page (s);
+}
+
+/* Returns the slab that contains OBJ, which must belong to cache
+   C. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	/* Check that the slab is valid. */
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT (pg_ofs (obj) >= c->first_ofs);
+	ASSERT ((pg_ofs (obj) - c->first_ofs) % c->slot_size == 0);
+
+	return s;
+}
@@ -31,6 +31,9 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCKSTAT
+#include "intrinsic.h"
+#endif
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,8 +50,21 @@ sema_init (struct semaphore *sema, unsigned value) {
 
 	sema->value = value;
 	list_init (&sema->waiters);
+#ifdef LOCKSTAT
+	sema->stat = NULL;
+#endif
 }
 
+#ifdef LOCKSTAT
+/* Initializes SEMA to VALUE, like sema_init(), and accounts its
+   down operations to the lockstat class NAME. */
+void
+sema_init_named (struct semaphore *sema, unsigned value, const char *name) {
+	sema_init (sema, value);
+	sema->stat = lockstat_lookup (name);
+}
+#endif
+
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
    to become positive and then atomically decrements it.
 
@@ -60,16 +76,27 @@ sema_init (struct semaphore *sema, unsigned value) {
 void
 sema_down (struct semaphore *sema) {
 	enum intr_level old_level;
+#ifdef LOCKSTAT
+	uint64_t start = rdtsc ();
+	bool contended = false;
+#endif
 
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
 	while (sema->value == 0) {
+#ifdef LOCKSTAT
+		contended = true;
+#endif
 		list_push_back (&sema->waiters, &thread_current ()->elem);
 		thread_block ();
 	}
 	sema->value--;
+#ifdef LOCKSTAT
+	if (sema->stat != NULL)
+		lockstat_record_wait (sema->stat, rdtsc () - start, contended);
+#endif
 	intr_set_level (old_level);
 }
 
@@ -124,11 +151,14 @@ sema_up (struct semaphore *sema) {
 		if (intr_context()) 
 			intr_yield_on_return();
 		else 
-			thread_yield();
+			thread_preempt();
 	}
 }
 
 static void sema_test_helper (void *sema_);
+static int hold_donated_priority (const struct lock_hold *);
+static bool donor_less (const struct heap_elem *, const struct heap_elem *, void *);
+static void rwlock_donate (struct rwlock *, struct thread *);
 
 /* Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
@@ -184,8 +214,22 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	heap_init (&lock->donors, donor_less, NULL);
+	lock->hold.donors = &lock->donors;
+#ifdef LOCKSTAT
+	lock->stat = lockstat_lookup (NULL);
+#endif
 }
 
+#ifdef LOCKSTAT
+/* Initializes LOCK, like lock_init(), and accounts it to the
+   lockstat class NAME. */
+void
+lock_init_named (struct lock *lock, const char *name) {
+	lock_init (lock);
+	lock->stat = lockstat_lookup (name);
+}
+#endif
 
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -205,65 +249,86 @@ lock_acquire (struct lock *lock) {
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	/* 만약 락이 이미 다른 스레드에 의해 잡혀있다면 */
-	if (lock->holder != NULL) {
+#ifdef LOCKSTAT
+	bool contended = lock->holder != NULL;
+	uint64_t start = rdtsc ();
+#endif
+
+	/* 만약 락이 이미 다른 스레드에 의해 잡혀있다면 (MLFQS에서는 기부 없음) */
+	bool donated = false;
+	if (!thread_mlfqs && lock->holder != NULL) {
 		cur->waiting_lock = lock; // "나는 이 락을 기다리고 있다" 표시
-		/* Add current thread to lock holder's donators list */
-		list_insert_ordered (&lock->holder->donators, &cur->donate_elem,
-		                     higher_priority_donate, NULL);
-		/* Donate priority through the chain */
-		propagate_eff_priority();
+		/* 락의 donors 힙에 나를 넣고 체인을 따라 기부 */
+		heap_insert (&lock->donors, &cur->donate_elem);
+		propagate_eff_priority (cur);
+		donated = true;
 	}
 
 	sema_down (&lock->semaphore); // 락을 얻을 때까지 대기 (블럭됨)
 	
 	/* 락을 얻었다! 이제 더 이상 기다리지 않음 */
 	cur->waiting_lock = NULL; // 기다리는 락 없음
+	if (donated)
+		heap_remove (&lock->donors, &cur->donate_elem);
 	lock->holder = cur; // 내가 락의 새로운 소유자
-	list_push_back(&cur->held_locks, &lock->elem); // 보유 락 리스트에 추가
+#ifdef LOCKSTAT
+	lock->acquired_tsc = rdtsc ();
+	lockstat_record_wait (lock->stat, lock->acquired_tsc - start, contended);
+#endif
+
+	/* 아직 기다리는 스레드들은 이제 나에게 기부한다 */
+	heap_insert (&cur->held_locks, &lock->hold.elem);
+	if (!thread_mlfqs)
+		recompute_eff_priority (cur);
 
 	intr_set_level(old);
 }
 
 /*
-	전파 동안 해야할 일
-	1. lock_donators 재정렬 : Cuz cur의 유효 우선순위가 바꼈으니 
-	2. 새로운 유효 우선순위 계산 및 검증 
-	3. 변경 됐고 ready상태라면 ready_list update
+	T의 유효 우선순위가 바뀌었을 때 기다리는 락의 체인을 따라 전파한다.
+	한 단계마다 할 일 (모두 O(log n))
+	1. T가 기다리는 락의 donors 힙에서 T의 위치 갱신
+	2. 그 락의 키(최고 대기자 우선순위)가 바뀌었으니 holder의 held_locks 힙 갱신
+	3. holder의 유효 우선순위 = max(base, held_locks 힙의 top) 으로 재계산
+	4. 바뀌었고 READY 상태라면 run queue 갱신, 다음 단계로
+	변화가 없으면 그 위로는 볼 필요가 없으므로 깊이 제한이 필요 없다.
 */
-void propagate_eff_priority() { // 퍼뜨리다!
+void propagate_eff_priority(struct thread *t) { // 퍼뜨리다!
 	enum intr_level old = intr_disable();
-	struct thread *cur = thread_current();
-	struct lock *w_lock = cur->waiting_lock;
-	int depth = 0;
-	const int MAX_DEPTH = 8; // 무한 루프 방지
+	struct lock *w_lock;
 	
- 	while ((w_lock = cur->waiting_lock) && w_lock->holder && depth < MAX_DEPTH)
+ 	while ((w_lock = t->waiting_lock) != NULL)
 	{
-		depth++;
 		struct thread *w_lock_holder = w_lock->holder;
 
-		// 1. lock_donators 재정렬
-		bool is_donator = is_contain(&w_lock_holder->donators, &cur->donate_elem);
-		if (!list_empty(&w_lock_holder->donators) && is_donator){
- 			list_remove(&cur->donate_elem);
-		}
- 		list_insert_ordered(&w_lock_holder->donators, &cur->donate_elem, 
-		higher_priority_donate, NULL);
+		// 1. donors 힙 위치는 holder가 없어도 항상 갱신
+		heap_update(&w_lock->donors, &t->donate_elem);
 
-		int before_eff = w_lock_holder->eff_priority;
-		if (cur->eff_priority <= before_eff) break;
+		// 락이 막 풀려 holder가 없으면 더 전파할 곳이 없음
+		if (w_lock_holder == NULL) break;
 
-		 // 2. 새로운 유효 우선순위 계산
+		// 2. holder의 held_locks 힙 갱신
+		heap_update(&w_lock_holder->held_locks, &w_lock->hold.elem);
+
+		// 3. 새로운 유효 우선순위 계산
+		int before_eff = w_lock_holder->eff_priority;
 		recompute_eff_priority(w_lock_holder);
 
-		// 변화 없으면 기부 안한걸로 치고 그 뒤 전파도 필요 없음
+		// 변화 없으면 그 뒤 전파도 필요 없음
 		if (w_lock_holder->eff_priority == before_eff) break; 
+#ifdef LOCKSTAT
+		if (w_lock_holder->eff_priority > before_eff)
+			lockstat_record_donation (w_lock->stat);
+#endif
 		if (w_lock_holder->status == THREAD_READY) {
 			requeue_ready_list(w_lock_holder);
 		}
-		cur = w_lock_holder;
+		t = w_lock_holder;
 	}
+
+	/* rwlock을 기다리는 중이라면 모든 holder에게 기부 */
+	if (t->waiting_rwlock != NULL)
+		rwlock_donate (t->waiting_rwlock, t);
 	
 	intr_set_level(old);
 }
@@ -282,9 +347,32 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	enum intr_level old = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
+	if (success) {
+		struct thread *cur = thread_current ();
+
+		lock->holder = cur;
+#ifdef LOCKSTAT
+		lock->acquired_tsc = rdtsc ();
+		lockstat_record_wait (lock->stat, 0, false);
+#endif
+
+		/* 깨어났지만 아직 락을 못 잡은 대기자가 donors에 남아 있을 수
+		   있으므로 lock_acquire()처럼 유효 우선순위를 다시 계산한다 */
+		heap_insert (&cur->held_locks, &lock->hold.elem);
+		if (!thread_mlfqs) {
+			int before_eff = cur->eff_priority;
+
+			recompute_eff_priority (cur);
+			if (cur->eff_priority != before_eff && cur->status == THREAD_READY)
+				requeue_ready_list (cur);
+		}
+	}
+	intr_set_level (old);
+
 	if (success)
-		lock->holder = thread_current ();
+		thread_preemption ();
 	return success;
 }
 
@@ -301,25 +389,19 @@ lock_release (struct lock *lock) {
 	
 	enum intr_level old = intr_disable();
 	struct thread *cur = lock->holder;
-	int before_eff_priority = cur->eff_priority;
 	
-	/* 1. 해당 Lock과 관련된 donators 제거 */
-	if (!list_empty(&cur->donators)){
-		remove_donators_related_lock(cur, lock);
-		/* 2. 유효 우선순위 재계산 */
+	/* 1. held_locks 힙에서 제거 => 이 락의 대기자들이 준 기부도 같이 사라짐 */
+	heap_remove(&cur->held_locks, &lock->hold.elem);
+
+	/* 2. 유효 우선순위 재계산 (힙의 top만 보면 됨) */
+	if (!thread_mlfqs)
 		recompute_eff_priority(cur);
-	}
-	
-	/* 3. 더 낮아졌고, READY상태라면 => ready_list 갱신 */
-	if ((before_eff_priority != cur->eff_priority) &&
-		cur->status == THREAD_READY) {
-		requeue_ready_list(cur);
-	}
-	
-	/* 4. held_locks 리스트에서 제거 */
-	list_remove(&lock->elem);
 	
-	/* 5. 본격적인 Lock 해제 작업 */
+#ifdef LOCKSTAT
+	lockstat_record_hold (lock->stat, rdtsc () - lock->acquired_tsc);
+#endif
+
+	/* 3. 본격적인 Lock 해제 작업 */
 	lock->holder = NULL;
 	sema_up (&lock->semaphore); // 여기서 어차피 unblock함
 	intr_set_level(old);
@@ -335,6 +417,355 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
+static bool read_may_enter (struct rwlock *);
+static void rwlock_wait (struct rwlock *, struct list *waiters,
+		struct list_elem *);
+static void rwlock_grant_read (struct rwlock *, struct rwlock_read_hold *);
+static void rwlock_grant_write (struct rwlock *, struct thread *);
+static void rwlock_refresh_holders (struct rwlock *);
+static void rwlock_wake (struct rwlock *);
+static void donate_to_holder (struct thread *, struct lock_hold *);
+
+/* Initializes RWLOCK.  If PREFER_WRITERS is true, new readers
+   wait while a writer is waiting; otherwise they wait only while
+   a writer holds the lock, which can starve writers. */
+void
+rwlock_init (struct rwlock *rwlock, bool prefer_writers) {
+	ASSERT (rwlock != NULL);
+
+	rwlock->writer = NULL;
+	list_init (&rwlock->readers);
+	list_init (&rwlock->read_waiters);
+	list_init (&rwlock->write_waiters);
+	heap_init (&rwlock->donors, donor_less, NULL);
+	rwlock->write_hold.donors = &rwlock->donors;
+	rwlock->prefer_writers = prefer_writers;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds
+   it (and, with writer preference, none is waiting).  RH records
+   the current thread's share; it must stay in place until
+   rwlock_release_read().  The current thread must not already
+   hold RWLOCK.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock, struct rwlock_read_hold *rh) {
+	enum intr_level old;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (rh != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_read_held_by_current_thread (rwlock));
+	ASSERT (!rwlock_write_held_by_current_thread (rwlock));
+
+	rh->rwlock = rwlock;
+	rh->thread = thread_current ();
+	old = intr_disable ();
+	if (read_may_enter (rwlock))
+		rwlock_grant_read (rwlock, rh);
+	else
+		rwlock_wait (rwlock, &rwlock->read_waiters, &rh->elem);
+	intr_set_level (old);
+}
+
+/* Tries to acquire RWLOCK for reading without sleeping, as
+   rwlock_acquire_read() would with RH.  Returns true if
+   successful, false on failure. */
+bool
+rwlock_try_acquire_read (struct rwlock *rwlock, struct rwlock_read_hold *rh) {
+	enum intr_level old;
+	bool success;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (rh != NULL);
+	ASSERT (!rwlock_read_held_by_current_thread (rwlock));
+	ASSERT (!rwlock_write_held_by_current_thread (rwlock));
+
+	rh->rwlock = rwlock;
+	rh->thread = thread_current ();
+	old = intr_disable ();
+	success = read_may_enter (rwlock);
+	if (success)
+		rwlock_grant_read (rwlock, rh);
+	intr_set_level (old);
+	return success;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading with share RH. */
+void
+rwlock_release_read (struct rwlock *rwlock, struct rwlock_read_hold *rh) {
+	struct thread *cur = thread_current ();
+	enum intr_level old;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (rh != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rh->rwlock == rwlock && rh->thread == cur);
+
+	old = intr_disable ();
+	list_remove (&rh->elem);
+	heap_remove (&cur->held_locks, &rh->hold.elem);
+	if (!thread_mlfqs)
+		recompute_eff_priority (cur);
+
+	if (list_empty (&rwlock->readers))
+		rwlock_wake (rwlock);
+	intr_set_level (old);
+
+	/* 기부가 사라졌거나 더 높은 스레드를 깨웠으면 양보 */
+	thread_preemption ();
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it.  The current thread must not already hold RWLOCK.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock) {
+	enum intr_level old;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_read_held_by_current_thread (rwlock));
+	ASSERT (!rwlock_write_held_by_current_thread (rwlock));
+
+	old = intr_disable ();
+	if (rwlock->writer == NULL && list_empty (&rwlock->readers))
+		rwlock_grant_write (rwlock, thread_current ());
+	else
+		rwlock_wait (rwlock, &rwlock->write_waiters, &thread_current ()->elem);
+	intr_set_level (old);
+}
+
+/* Tries to acquire RWLOCK for writing without sleeping.  Returns
+   true if successful, false on failure. */
+bool
+rwlock_try_acquire_write (struct rwlock *rwlock) {
+	enum intr_level old;
+	bool success;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (!rwlock_read_held_by_current_thread (rwlock));
+	ASSERT (!rwlock_write_held_by_current_thread (rwlock));
+
+	old = intr_disable ();
+	success = rwlock->writer == NULL && list_empty (&rwlock->readers);
+	if (success)
+		rwlock_grant_write (rwlock, thread_current ());
+	intr_set_level (old);
+	return success;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rwlock) {
+	struct thread *cur = thread_current ();
+	enum intr_level old;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rwlock_write_held_by_current_thread (rwlock));
+
+	old = intr_disable ();
+	rwlock->writer = NULL;
+	heap_remove (&cur->held_locks, &rwlock->write_hold.elem);
+	if (!thread_mlfqs)
+		recompute_eff_priority (cur);
+
+	rwlock_wake (rwlock);
+	intr_set_level (old);
+
+	thread_preemption ();
+}
+
+/* Returns true if the current thread holds RWLOCK for reading,
+   false otherwise. */
+bool
+rwlock_read_held_by_current_thread (const struct rwlock *rwlock) {
+	struct list *readers = (struct list *) &rwlock->readers;
+	struct thread *cur = thread_current ();
+	struct list_elem *e;
+	bool held = false;
+	enum intr_level old;
+
+	ASSERT (rwlock != NULL);
+
+	old = intr_disable ();
+	for (e = list_begin (readers); e != list_end (readers); e = list_next (e))
+		if (list_entry (e, struct rwlock_read_hold, elem)->thread == cur) {
+			held = true;
+			break;
+		}
+	intr_set_level (old);
+	return held;
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	return rwlock->writer == thread_current ();
+}
+
+/* Returns true if a new reader may enter RWLOCK right away. */
+static bool
+read_may_enter (struct rwlock *rwlock) {
+	if (rwlock->writer != NULL)
+		return false;
+	return !rwlock->prefer_writers || list_empty (&rwlock->write_waiters);
+}
+
+/* Blocks the current thread on WAITERS, one of RWLOCK's wait
+   lists, donating its priority to RWLOCK's holders.  ELEM is
+   what goes in WAITERS: the thread's elem for a writer, its
+   share's for a reader.  Returns once a releasing thread has
+   handed RWLOCK over.  Interrupts must be off. */
+static void
+rwlock_wait (struct rwlock *rwlock, struct list *waiters,
+		struct list_elem *elem) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	cur->waiting_rwlock = rwlock;
+	if (!thread_mlfqs) {
+		heap_insert (&rwlock->donors, &cur->donate_elem);
+		rwlock_donate (rwlock, cur);
+	}
+	list_push_back (waiters, elem);
+	thread_block ();
+	ASSERT (cur->waiting_rwlock == NULL);
+}
+
+/* Makes RH's thread, which either is the current thread or is
+   blocked on RWLOCK, a reader of RWLOCK. */
+static void
+rwlock_grant_read (struct rwlock *rwlock, struct rwlock_read_hold *rh) {
+	struct thread *t = rh->thread;
+
+	if (t->waiting_rwlock == rwlock) {
+		t->waiting_rwlock = NULL;
+		if (!thread_mlfqs)
+			heap_remove (&rwlock->donors, &t->donate_elem);
+	}
+	rh->hold.donors = &rwlock->donors;
+	list_push_back (&rwlock->readers, &rh->elem);
+	heap_insert (&t->held_locks, &rh->hold.elem);
+	if (!thread_mlfqs)
+		recompute_eff_priority (t);
+}
+
+/* Makes T, which either is the current thread or is blocked on
+   RWLOCK, the writer of RWLOCK. */
+static void
+rwlock_grant_write (struct rwlock *rwlock, struct thread *t) {
+	if (t->waiting_rwlock == rwlock) {
+		t->waiting_rwlock = NULL;
+		if (!thread_mlfqs)
+			heap_remove (&rwlock->donors, &t->donate_elem);
+	}
+	rwlock->writer = t;
+	heap_insert (&t->held_locks, &rwlock->write_hold.elem);
+	if (!thread_mlfqs)
+		recompute_eff_priority (t);
+}
+
+/* Hands RWLOCK, which nobody holds, to its waiters: the
+   highest-priority waiting writer if writers are preferred or
+   no reader waits, otherwise every waiting reader. */
+static void
+rwlock_wake (struct rwlock *rwlock) {
+	struct list_elem *e;
+
+	ASSERT (rwlock->writer == NULL && list_empty (&rwlock->readers));
+
+	if (!list_empty (&rwlock->write_waiters)
+			&& (rwlock->prefer_writers || list_empty (&rwlock->read_waiters))) {
+		e = list_min (&rwlock->write_waiters, thread_priority_compare, NULL);
+		list_remove (e);
+		rwlock_grant_write (rwlock, list_entry (e, struct thread, elem));
+	} else {
+		while (!list_empty (&rwlock->read_waiters)) {
+			e = list_pop_front (&rwlock->read_waiters);
+			rwlock_grant_read (rwlock,
+					list_entry (e, struct rwlock_read_hold, elem));
+		}
+	}
+
+	/* The new holders inherit the donations of whoever still
+	   waits, so fix up their priorities before they run. */
+	rwlock_refresh_holders (rwlock);
+
+	if (rwlock->writer != NULL)
+		thread_unblock (rwlock->writer);
+	for (e = list_begin (&rwlock->readers); e != list_end (&rwlock->readers);
+			e = list_next (e))
+		thread_unblock (list_entry (e, struct rwlock_read_hold, elem)->thread);
+}
+
+/* Re-sorts RWLOCK's share in each holder's held_locks after the
+   top of RWLOCK's donors changed, and recomputes the holders'
+   priorities. */
+static void
+rwlock_refresh_holders (struct rwlock *rwlock) {
+	struct list_elem *e;
+
+	if (thread_mlfqs)
+		return;
+
+	if (rwlock->writer != NULL) {
+		heap_update (&rwlock->writer->held_locks, &rwlock->write_hold.elem);
+		recompute_eff_priority (rwlock->writer);
+	}
+	for (e = list_begin (&rwlock->readers); e != list_end (&rwlock->readers);
+			e = list_next (e)) {
+		struct rwlock_read_hold *rh = list_entry (e, struct rwlock_read_hold, elem);
+
+		heap_update (&rh->thread->held_locks, &rh->hold.elem);
+		recompute_eff_priority (rh->thread);
+	}
+}
+
+/* T, which waits on RWLOCK, has a new effective priority.
+   Passes it on to every holder of RWLOCK: the writer, or all of
+   the readers, since any of them may be what T waits for. */
+static void
+rwlock_donate (struct rwlock *rwlock, struct thread *t) {
+	struct list_elem *e;
+
+	heap_update (&rwlock->donors, &t->donate_elem);
+	if (rwlock->writer != NULL)
+		donate_to_holder (rwlock->writer, &rwlock->write_hold);
+	for (e = list_begin (&rwlock->readers); e != list_end (&rwlock->readers);
+			e = list_next (e)) {
+		struct rwlock_read_hold *rh = list_entry (e, struct rwlock_read_hold, elem);
+
+		donate_to_holder (rh->thread, &rh->hold);
+	}
+}
+
+/* HOLDER의 HOLD 키가 바뀌었으니 held_locks 힙을 갱신하고
+   유효 우선순위가 바뀌었으면 HOLDER가 기다리는 쪽으로 계속 전파 */
+static void
+donate_to_holder (struct thread *holder, struct lock_hold *hold) {
+	int before_eff = holder->eff_priority;
+
+	heap_update (&holder->held_locks, &hold->elem);
+	recompute_eff_priority (holder);
+	if (holder->eff_priority == before_eff)
+		return;
+	if (holder->status == THREAD_READY)
+		requeue_ready_list (holder);
+	propagate_eff_priority (holder);
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem {
 	struct list_elem elem;              /* List element. */
@@ -426,21 +857,18 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 
 /* ========== Priority Donation Helper Functions ========== */
 
-/* 스레드의 유효 우선순위를 재계산합니다 */
+/* 스레드의 유효 우선순위를 재계산합니다.
+   보유한 락들의 힙 top이 받은 기부 중 최고값이므로 O(1) */
 void recompute_eff_priority(struct thread *t) {
 	ASSERT(t != NULL);
 	
 	int max_priority = t->base_priority; // 기본 우선순위부터 시작
 	
-	/* 기부자들 중 최고 우선순위 찾기 */
-	if (!list_empty(&t->donators)) {
-		struct list_elem *e;
-		for (e = list_begin(&t->donators); e != list_end(&t->donators); e = list_next(e)) {
-			struct thread *donator = list_entry(e, struct thread, donate_elem);
-			if (donator->eff_priority > max_priority) {
-				max_priority = donator->eff_priority;
-			}
-		}
+	struct heap_elem *top = heap_top(&t->held_locks);
+	if (top != NULL) {
+		int donated = hold_donated_priority(heap_entry(top, struct lock_hold, elem));
+		if (donated > max_priority)
+			max_priority = donated;
 	}
 	
 	t->eff_priority = max_priority;
@@ -448,43 +876,26 @@ void recompute_eff_priority(struct thread *t) {
 
 /* Ready 리스트에서 스레드를 재정렬합니다 - thread.c에서 구현됨 */
 
-/* 우선순위 비교 함수 (기부자 리스트용) */
-bool higher_priority_donate(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	struct thread *ta = list_entry(a, struct thread, donate_elem);
-	struct thread *tb = list_entry(b, struct thread, donate_elem);
-	return ta->eff_priority > tb->eff_priority;
+/* HOLD를 통해 기부하는 대기자들의 최고 유효 우선순위. 대기자가 없으면 PRI_MIN - 1 */
+static int hold_donated_priority(const struct lock_hold *hold) {
+	struct heap_elem *top = heap_top(hold->donors);
+	if (top == NULL)
+		return PRI_MIN - 1;
+	return heap_entry(top, struct thread, donate_elem)->eff_priority;
 }
 
-/* 특정 락과 관련된 기부자들을 제거합니다 */
-void remove_donators_related_lock(struct thread *t, struct lock *lock) {
-	ASSERT(t != NULL);
-	ASSERT(lock != NULL);
-	
-	struct list_elem *e = list_begin(&t->donators);
-	
-	while (e != list_end(&t->donators)) {
-		struct thread *donator = list_entry(e, struct thread, donate_elem);
-		struct list_elem *next = list_next(e);
-		
-		if (donator->waiting_lock == lock) {
-			list_remove(e);
-		}
-		e = next;
-	}
+/* 우선순위 비교 함수 (락의 donors 힙용) */
+static bool donor_less(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	const struct thread *ta = heap_entry(a, struct thread, donate_elem);
+	const struct thread *tb = heap_entry(b, struct thread, donate_elem);
+	return ta->eff_priority < tb->eff_priority;
 }
 
-/* 리스트에 특정 요소가 포함되어 있는지 확인 */
-bool is_contain(struct list *list, struct list_elem *elem) {
-	ASSERT(list != NULL);
-	ASSERT(elem != NULL);
-	
-	struct list_elem *e;
-	for (e = list_begin(list); e != list_end(list); e = list_next(e)) {
-		if (e == elem) {
-			return true;
-		}
-	}
-	return false;
+/* 우선순위 비교 함수 (스레드의 held_locks 힙용) */
+bool held_lock_less(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	const struct lock_hold *ha = heap_entry(a, struct lock_hold, elem);
+	const struct lock_hold *hb = heap_entry(b, struct lock_hold, elem);
+	return hold_donated_priority(ha) < hold_donated_priority(hb);
 }
 
 /* Condition variable의 semaphore_elem 우선순위 비교 함수 */
@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -7,9 +8,11 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,9 +27,22 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.
+
+   우선순위(PRI_MIN ~ PRI_MAX)마다 FIFO 큐를 하나씩 두고,
+   비어 있지 않은 큐를 ready_bitmap의 비트로 표시한다.
+   가장 높은 우선순위는 비트 스캔 한 번으로 찾을 수 있으므로
+   삽입/삭제/선택이 모두 O(1)이다. */
+#define READY_QUEUE_CNT (PRI_MAX - PRI_MIN + 1)
+static struct list ready_queues[READY_QUEUE_CNT];
+static uint64_t ready_bitmap;      /* Bit P set iff ready_queues[P] is nonempty. */
+static int ready_count;            /* # of threads in the run queue. */
+
+/* List of all live threads.  Threads are added when they are
+   first initialized and removed when they exit.  Only the
+   MLFQS once-per-second recent_cpu decay walks it. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -40,6 +56,23 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Recycled thread pages.  Pages of dead threads are kept here,
+   up to THREAD_CACHE_MAX of them, instead of going back to the
+   page allocator, so that thread_create() can skip the pool lock,
+   the bitmap scan and zeroing the whole page.  Linked through the
+   dead thread's `elem'.  Accessed with interrupts off.
+
+   The scheduler puts every dead page here, since it cannot take
+   the page allocator's lock; thread_cache_trim() gives the pages
+   beyond THREAD_CACHE_MAX back later, from thread context. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;        /* # of pages in thread_cache. */
+static size_t thread_cache_high;       /* Highest thread_cache_cnt seen. */
+static long long thread_cache_hits;    /* thread_create()s served from the cache. */
+static long long thread_cache_misses;  /* thread_create()s that went to palloc. */
+static long long thread_cache_frees;   /* Dead pages returned to palloc. */
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
@@ -49,6 +82,20 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Scheduling latency tracing.  Totals of all threads, including
+   ones that have exited, and the wake-to-run histogram. */
+static uint64_t sched_wake_hist[SCHED_HIST_BUCKETS];
+static long long sched_leaves[SCHED_LEAVE_CNT];
+static enum sched_leave yield_reason;   /* Reason for the pending thread_yield(). */
+
+/* MLFQS.  System load average, 17.14 fixed point. */
+static fixed_t load_avg;
+
+/* MLFQS.  Threads whose recent_cpu was charged since their
+   priority was last recomputed.  Usually just the running
+   thread, plus any that ran earlier in the same 4-tick window. */
+static struct list charged_list;
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -60,9 +107,21 @@ static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
+static void do_yield (enum sched_leave);
+static void sched_account (struct thread *curr, struct thread *next);
+static struct thread *thread_page_alloc (void);
+static void thread_page_free (struct thread *);
+static void thread_cache_trim (void);
 static void schedule (void);
 static tid_t allocate_tid (void);
-static void thread_preemption (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_link (struct thread *);
+static void ready_queue_unlink (struct thread *);
+static int ready_queue_top_priority (void);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_decay (void);
+static void mlfqs_update_charged (void);
 void thread_update_priority (struct thread *t);
 void thread_donate_priority (struct thread *t);
 
@@ -109,15 +168,23 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
+	lock_init_named (&tid_lock, "tid");
+	for (int i = 0; i < READY_QUEUE_CNT; i++)
+		list_init (&ready_queues[i]);
+	ready_bitmap = 0;
+	ready_count = 0;
+	list_init (&all_list);
 	list_init (&destruction_req);
+	list_init (&thread_cache);
+	load_avg = 0;
+	list_init (&charged_list);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	initial_thread->sched.run_tsc = rdtsc ();
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -126,6 +193,7 @@ void
 thread_start (void) {
 	/* Create the idle thread. */
 	struct semaphore idle_started;
+
 	sema_init (&idle_started, 0);
 	thread_create ("idle", PRI_MIN, idle, &idle_started);
 
@@ -152,16 +220,54 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
 }
 
+/* Called by the timer interrupt handler for IDLE ticks that went
+   by with the CPU halted in the idle thread, after it has run the
+   timing wheel through them, so that the last of them is
+   timer_ticks().  Books them as idle time and, under MLFQS, does
+   the periodic work that fell due in them.  thread_tick() still
+   runs for the tick that raised the interrupt. */
+void
+thread_idle_ticks (int64_t idle) {
+	int64_t now = timer_ticks ();
+
+	ASSERT (intr_context ());
+
+	idle_ticks += idle;
+	if (!thread_mlfqs || idle == 0)
+		return;
+
+	/* 쉬는 동안 CPU를 쓴 스레드는 없으므로 recent_cpu는 그대로 두고,
+	   지나간 1초 경계마다 감쇠, 아니면 밀린 4틱 갱신만 한다 */
+	int64_t seconds = now / TIMER_FREQ - (now - idle) / TIMER_FREQ;
+	if (seconds > 0) {
+		while (seconds-- > 0)
+			mlfqs_decay ();
+	} else if (now / 4 - (now - idle) / 4 > 0)
+		mlfqs_update_charged ();
+	else
+		return;
+
+	if (ready_bitmap != 0
+	    && ready_queue_top_priority () > thread_current ()->eff_priority)
+		intr_yield_on_return ();
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread cache: %lld hits, %lld misses, %lld frees, %zu high water\n",
+			thread_cache_hits, thread_cache_misses, thread_cache_frees,
+			thread_cache_high);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -187,10 +293,11 @@ thread_create (const char *name, int priority,
 
 	ASSERT (function != NULL); // 함수 포인터가 유효한지 검증 
 
-	t = palloc_get_page (PAL_ZERO); // 새 스레드를 위한 페이지(4KB)를 할당
+	t = thread_page_alloc (); // 새 스레드를 위한 페이지(4KB)를 할당 (재활용 우선)
 
 	if (t == NULL) // 할당 실패 시
 		return TID_ERROR; // TID_ERROR 반환
+	thread_cache_trim (); // 죽은 스레드들이 남긴 여분의 페이지 반납
 
 	/* Initialize thread. */
 	init_thread (t, name, priority); // 스레드 구조체 초기화 (이름, 우선순위 등 설정)
@@ -210,7 +317,7 @@ thread_create (const char *name, int priority,
 	t->tf.eflags = FLAG_IF; // 인터럽트 활성화 플래그
 
 	/* Add to run queue. */
-	thread_unblock (t); // 새 스레드를 ready_list에 추가(우선순위 순서로)
+	thread_unblock (t); // 새 스레드를 run queue에 추가(우선순위별 큐의 맨 뒤)
 	
 	thread_preemption();  // 새 스레드가 더 높은 우선순위면 즉시 스케줄링
 
@@ -244,7 +351,7 @@ thread_block (void) {
 */
 
 /* 
-   ready_list를 우선순위 내림차순으로 유지하기 위한 비교자
+   세마포어 대기자 리스트 등을 우선순위 내림차순으로 정렬하기 위한 비교자
    우선순위가 높을수록 앞에 오도록 정렬 (내림차순)
 */
 bool thread_priority_compare(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
@@ -254,18 +361,17 @@ bool thread_priority_compare(const struct list_elem *a, const struct list_elem *
 	return ta->eff_priority > tb->eff_priority; // 유효 우선 순위가 클수록 먼저임
 }
 
-/* ready_list 맨 앞(최고 우선순위)이 현재보다 높으면 양보 */
-static void thread_preemption(void) {
+/* run queue의 최고 우선순위가 현재보다 높으면 양보 */
+void thread_preemption(void) {
   if (intr_context()) return;                    // (1) ISR(인터럽트 핸들러) 컨텍스트에선 '즉시 스위치' 금지.
                                                  //     ※ 복귀 직후 스케줄이 필요하면 다른 경로(need_resched/intr_yield_on_return 등)에서 처리해야 함.
 
   enum intr_level old = intr_disable();          // (2) 짧은 임계구역 진입: 검사→결정→상태수정을 인터럽트 끼어듦 없이 원자적으로 수행
-  if (!list_empty(&ready_list)) {                // (3) 대기 스레드가 하나라도 있으면
-    int top = list_entry(list_front(&ready_list),
-                         struct thread, elem)->eff_priority; // (4) 대기열 맨 앞(최우선) 스레드의 유효 우선순위 확인
+  if (ready_bitmap != 0) {                       // (3) 대기 스레드가 하나라도 있으면
+    int top = ready_queue_top_priority();        // (4) 비트 스캔 한 번으로 최고 유효 우선순위 확인
     if (top > thread_current()->eff_priority) {      // (5) 더 높은 유효 우선순위 스레드가 준비됨 → 선점 필요
       intr_set_level(old);                       // (6) 임계구역 종료: 인터럽트 상태 복구
-      thread_yield();                            // (7) 즉시 양보하여 스케줄러가 높은 우선순위를 태우게 함
+      thread_preempt();                          // (7) 즉시 양보하여 스케줄러가 높은 우선순위를 태우게 함
       return;                                    // (8) 양보했으므로 종료
     }
   }
@@ -277,16 +383,61 @@ void thread_update_priority (struct thread *t) {
   recompute_eff_priority(t);
 }
 
-/* Ready 리스트에서 스레드를 재정렬합니다 */
+/* T를 유효 우선순위에 해당하는 큐의 맨 뒤에 넣는다.
+   같은 우선순위끼리는 FIFO 순서가 유지된다.
+   인터럽트가 꺼진 상태에서 호출해야 한다. */
+static void
+ready_queue_push (struct thread *t) {
+	t->sched.ready_tsc = rdtsc ();
+	ready_queue_link (t);
+}
+
+/* ready_queue_push()의 본체.  대기 시작 시각은 건드리지 않는다.
+   인터럽트가 꺼진 상태에서 호출해야 한다. */
+static void
+ready_queue_link (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->eff_priority && t->eff_priority <= PRI_MAX);
+
+	t->ready_priority = t->eff_priority;
+	list_push_back (&ready_queues[t->ready_priority], &t->elem);
+	ready_bitmap |= 1ULL << t->ready_priority;
+	ready_count++;
+}
+
+/* T를 현재 들어 있는 큐에서 뺀다.  큐가 비면 비트도 지운다.
+   eff_priority가 이미 바뀌었을 수 있으므로 넣을 때 기록해 둔
+   ready_priority를 기준으로 한다.  인터럽트가 꺼진 상태에서 호출해야 한다. */
+static void
+ready_queue_unlink (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_remove (&t->elem);
+	if (list_empty (&ready_queues[t->ready_priority]))
+		ready_bitmap &= ~(1ULL << t->ready_priority);
+	ready_count--;
+}
+
+/* 비어 있지 않은 큐 중 가장 높은 우선순위를 반환한다.
+   run queue가 비어 있으면 안 된다. */
+static int
+ready_queue_top_priority (void) {
+	ASSERT (ready_bitmap != 0);
+	return 63 - __builtin_clzll (ready_bitmap);
+}
+
+/* 유효 우선순위가 바뀐 READY 스레드를 새 우선순위의 큐로 옮깁니다 (O(1)) */
 void requeue_ready_list(struct thread *t) {
 	ASSERT(t != NULL);
 	ASSERT(t->status == THREAD_READY);
 	
 	enum intr_level old_level = intr_disable();
 	
-	/* Ready 리스트에서 제거 후 우선순위에 따라 다시 삽입 */
-	list_remove(&t->elem);
-	list_insert_ordered(&ready_list, &t->elem, thread_priority_compare, NULL);
+	/* 기존 큐에서 빼서 새 우선순위 큐의 맨 뒤에 넣음 */
+	if (t->ready_priority != t->eff_priority) {
+		ready_queue_unlink(t);
+		ready_queue_link(t);
+	}
 	
 	intr_set_level(old_level);
 }
@@ -315,10 +466,10 @@ thread_unblock (struct thread *t) {
 	ASSERT (t->status == THREAD_BLOCKED); // 스레드가 정말 blocked 상태인지 확인
 
 	/*
-		ready_list에 우선순위 순서대로 삽입
-		thread_priority_compare 함수로 우선순위 내림차순 정렬
+		유효 우선순위에 해당하는 run queue의 맨 뒤에 삽입 (O(1))
 	*/
-	list_insert_ordered(&ready_list, &t->elem, thread_priority_compare, NULL);
+	ready_queue_push(t);
+	t->sched.woken = true; // 깨어나서 실행되기까지의 지연을 기록
 
 	t->status = THREAD_READY; // 스레드 상태를 ready로 변경
 
@@ -349,6 +500,18 @@ thread_current (void) {
 	return t;
 }
 
+/* Invokes FUNC on every thread, passing along AUX.  Must be
+   called with interrupts off. */
+void
+thread_foreach (thread_action_func *func, void *aux) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e))
+		func (list_entry (e, struct thread, allelem), aux);
+}
+
 /* Returns the running thread's tid. */
 tid_t
 thread_tid (void) {
@@ -364,10 +527,18 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	/* 캐시해 둔 malloc 블록들을 디스크립터에 돌려줍니다.
+	   이 뒤로는 free()를 부르면 안 됩니다. 블록이 다시 비워지지
+	   않을 매거진에 남습니다. */
+	malloc_thread_exit ();
+	thread_cache_trim ();
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	list_remove (&thread_current ()->allelem);
+	if (thread_current ()->cpu_charged)
+		list_remove (&thread_current ()->charged_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -376,6 +547,19 @@ thread_exit (void) {
    스케줄러의 재량에 따라 즉시 다시 스케줄될 수 있습니다. */
 void
 thread_yield (void) {
+	do_yield (SCHED_YIELD);
+}
+
+/* thread_yield()와 같지만 스스로 양보한 것이 아니라 선점당한 것으로
+   기록합니다.  타임 슬라이스 만료나 더 높은 우선순위 스레드가
+   준비되었을 때 사용합니다. */
+void
+thread_preempt (void) {
+	do_yield (SCHED_PREEMPT);
+}
+
+static void
+do_yield (enum sched_leave reason) {
 	struct thread *curr = thread_current (); // 현재 실행 중인 스레드 포인터 가져오기
 
 	enum intr_level old_level; // 인터럽트 레벨 저장용 변수
@@ -385,12 +569,13 @@ thread_yield (void) {
 	old_level = intr_disable (); // 임계구역 시작 - 스케줄링 도중 인터럽트 방지
 
 	/*
-		idle_thread가 아니라면 ready_list에 다시 삽입
-		우선순위 순서대로 삽입하여 다음 스케줄링 때 순서 보장
+		idle_thread가 아니라면 run queue에 다시 삽입
+		같은 우선순위 큐의 맨 뒤로 가므로 라운드 로빈 순서 보장
 	*/
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, thread_priority_compare, NULL); // 우선순위 정렬 추가
+		ready_queue_push(curr); // 우선순위별 큐에 추가
 
+	yield_reason = reason; // schedule()에서 떠난 이유로 기록
 	do_schedule (THREAD_READY); // 스케줄러 호출 - 현재 스레드는 ready 상태로 변경되고 다른 스레드로 전환
 	intr_set_level (old_level); // 임계구역 종료 (새로 스케줄된 스레드가 실행됨)
 }
@@ -399,6 +584,10 @@ thread_yield (void) {
 void
 thread_set_priority (int new_priority) {
 	struct thread *cur = thread_current ();
+
+	/* MLFQS에서는 스케줄러가 우선순위를 직접 계산하므로 무시 */
+	if (thread_mlfqs)
+		return;
 	
 	enum intr_level old = intr_disable();
 	cur->base_priority = new_priority; // 기본 우선순위 업데이트
@@ -412,11 +601,10 @@ thread_set_priority (int new_priority) {
 	}
 	
 	/* 더 높은 우선순위 깨우는 작업 */
-	if (!list_empty(&ready_list)){
-		struct thread *first = list_entry(list_front(&ready_list), struct thread, elem);
-		if (first->eff_priority > cur->eff_priority) {
+	if (ready_bitmap != 0){
+		if (ready_queue_top_priority() > cur->eff_priority) {
 			intr_set_level(old);
-			thread_yield();
+			thread_preempt();
 			return;
 		}
 	}
@@ -439,29 +627,145 @@ thread_get_priority (void) {
 
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	enum intr_level old = intr_disable ();
+	cur->nice = nice;
+	if (thread_mlfqs)
+		mlfqs_update_priority (cur); // nice가 바뀌었으니 내 우선순위만 다시 계산
+	intr_set_level (old);
+
+	thread_preemption (); // 더 높은 우선순위가 생겼으면 양보
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old = intr_disable ();
+	int value = fp_to_int_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old);
+	return value;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old = intr_disable ();
+	int value = fp_to_int_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	intr_set_level (old);
+	return value;
+}
+
+/* ========== MLFQS (4.4BSD scheduler) ========== */
+
+/* T의 recent_cpu와 nice로 우선순위를 다시 계산한다.
+     priority = PRI_MAX - (recent_cpu / 4) - (nice * 2)
+   기부는 MLFQS에서 쓰지 않으므로 base/eff를 같이 바꾼다.
+   READY 상태라면 run queue도 옮긴다. */
+static void
+mlfqs_update_priority (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t == idle_thread)
+		return;
+
+	fixed_t p = fp_sub (fp_from_int (PRI_MAX), fp_div_int (t->recent_cpu, 4));
+	int priority = fp_to_int (fp_sub_int (p, t->nice * 2));
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+
+	if (priority == t->eff_priority)
+		return;
+	t->priority = t->base_priority = t->eff_priority = priority;
+	if (t->status == THREAD_READY)
+		requeue_ready_list (t);
+}
+
+/* 1초마다 load_avg를 갱신하고 모든 스레드의 recent_cpu를 감쇠시킨다.
+     load_avg = (59/60) * load_avg + (1/60) * ready_threads
+     recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice
+   감쇠 계수는 한 번만 계산하고, recent_cpu가 실제로 바뀐
+   스레드만 우선순위를 다시 계산한다. */
+static void
+mlfqs_decay (void) {
+	/* 아래에서 모든 스레드를 다시 보므로 charged_list는 비운다 */
+	while (!list_empty (&charged_list))
+		list_entry (list_pop_front (&charged_list),
+		            struct thread, charged_elem)->cpu_charged = false;
+
+	int ready_threads = ready_count;
+	if (thread_current () != idle_thread)
+		ready_threads++;
+
+	load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+	                   fp_div_int (fp_from_int (ready_threads), 60));
+
+	fixed_t twice_load = fp_mul_int (load_avg, 2);
+	fixed_t coef = fp_div (twice_load, fp_add_int (twice_load, 1));
+
+	struct list_elem *e;
+	for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, allelem);
+		if (t == idle_thread)
+			continue;
+
+		fixed_t rc = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+		if (rc == t->recent_cpu)
+			continue;
+		t->recent_cpu = rc;
+		mlfqs_update_priority (t);
+	}
+}
+
+/* recent_cpu가 늘어난 스레드들의 우선순위만 다시 계산한다. */
+static void
+mlfqs_update_charged (void) {
+	while (!list_empty (&charged_list)) {
+		struct thread *t = list_entry (list_pop_front (&charged_list),
+		                               struct thread, charged_elem);
+		t->cpu_charged = false;
+		mlfqs_update_priority (t);
+	}
+}
+
+/* 매 틱마다 타이머 인터럽트에서 호출된다.
+   실행 중인 스레드의 recent_cpu만 1 증가시키고, 4틱마다 그동안
+   CPU를 쓴 스레드들의 우선순위만 다시 계산한다 (다른 스레드의
+   입력은 변하지 않았으므로).  1초 경계에서는 mlfqs_decay()가
+   한 번에 처리한다.  스레드 수와 무관하게 틱당 비용이 일정하다. */
+static void
+mlfqs_tick (struct thread *t) {
+	int64_t now = timer_ticks ();
+
+	if (t != idle_thread) {
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+		if (!t->cpu_charged) {
+			t->cpu_charged = true;
+			list_push_back (&charged_list, &t->charged_elem);
+		}
+	}
+
+	if (now % TIMER_FREQ == 0)
+		mlfqs_decay ();
+	else if (now % 4 == 0)
+		mlfqs_update_charged ();
+	else
+		return;
+
+	/* 더 높은 우선순위가 생겼으면 인터럽트 복귀 시 양보 */
+	if (ready_bitmap != 0 && ready_queue_top_priority () > t->eff_priority)
+		intr_yield_on_return ();
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -478,6 +782,10 @@ idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
 	idle_thread = thread_current ();
+	/* init_thread()는 idle_thread가 정해지기 전에 불리므로 -mlfqs에서는
+	   idle의 우선순위를 다른 스레드처럼 계산해 두었습니다.  되돌립니다. */
+	idle_thread->priority = idle_thread->base_priority
+		= idle_thread->eff_priority = PRI_MIN;
 	sema_up (idle_started);
 
 	for (;;) {
@@ -485,6 +793,18 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* 실행할 스레드가 없으면 0으로 채운 페이지 예비분을 한 장
+		   채우고 다시 양보합니다.  한 장마다 run queue를 다시 보므로
+		   깨어난 스레드가 오래 기다리지 않습니다. */
+		intr_enable ();
+		if (palloc_prezero ())
+			continue;
+		intr_disable ();
+
+		/* Nothing is runnable: in tickless mode, sleep until the
+		   next timer deadline instead of the next periodic tick. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -516,6 +836,8 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -530,11 +852,26 @@ init_thread (struct thread *t, const char *name, int priority) {
 	/* Initialize priority donation fields */
 	t->base_priority = priority; // 기본 우선순위 초기값
 	t->eff_priority = priority; // 유효 우선순위 초기값
-	list_init (&t->donators); // 우선순위를 기부하는 스레드들의 리스트
 	t->waiting_lock = NULL; // 대기 중인 락 없음
-	list_init (&t->held_locks); // 보유 중인 락들의 리스트
+	t->waiting_rwlock = NULL; // 대기 중인 rwlock 없음
+	heap_init (&t->held_locks, held_lock_less, NULL); // 보유 중인 락들의 힙
+
+	/* MLFQS: 부모의 nice와 recent_cpu를 물려받는다 */
+	if (t == initial_thread) {
+		t->nice = NICE_DEFAULT;
+		t->recent_cpu = 0;
+	} else {
+		t->nice = running_thread ()->nice;
+		t->recent_cpu = running_thread ()->recent_cpu;
+	}
 	
 	t->magic = THREAD_MAGIC;
+
+	old_level = intr_disable ();
+	if (thread_mlfqs)
+		mlfqs_update_priority (t);
+	list_push_back (&all_list, &t->allelem);
+	intr_set_level (old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -544,10 +881,14 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct thread *t = idle_thread;
+
+	if (ready_bitmap != 0) {
+		struct list *q = &ready_queues[ready_queue_top_priority ()];
+		t = list_entry (list_front (q), struct thread, elem);
+		ready_queue_unlink (t);
+	}
+	return t;
 }
 
 /* Use iretq to launch the thread */
@@ -658,7 +999,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		thread_page_free (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -667,7 +1008,13 @@ do_schedule(int status) {
 static void
 schedule (void) {
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+	struct thread *next;
+
+	/* Leaving idle: restore the periodic tick before anyone else
+	   runs, so that timer_ticks() and time slices stay correct. */
+	if (curr == idle_thread)
+		timer_idle_exit ();
+	next = next_thread_to_run ();
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
@@ -678,6 +1025,8 @@ schedule (void) {
 	/* Start new time slice. */
 	thread_ticks = 0;
 
+	sched_account (curr, next);
+
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
@@ -702,6 +1051,151 @@ schedule (void) {
 	}
 }
 
+/* Records that CURR is leaving the CPU and NEXT is being
+   dispatched.  Called by schedule() with interrupts off. */
+static void
+sched_account (struct thread *curr, struct thread *next) {
+	uint64_t now = rdtsc ();
+	enum sched_leave reason;
+
+	if (curr != idle_thread) {
+		if (curr->status == THREAD_DYING)
+			reason = SCHED_EXIT;
+		else if (curr->status == THREAD_BLOCKED)
+			reason = SCHED_BLOCK;
+		else
+			reason = yield_reason;
+		curr->sched.run_cycles += now - curr->sched.run_tsc;
+		curr->sched.leaves[reason]++;
+		sched_leaves[reason]++;
+	}
+
+	if (next != idle_thread) {
+		uint64_t wait = now - next->sched.ready_tsc;
+
+		next->sched.wait_cycles += wait;
+		if (next->sched.woken) {
+			int bucket = wait == 0 ? 0 : 63 - __builtin_clzll (wait);
+			if (bucket >= SCHED_HIST_BUCKETS)
+				bucket = SCHED_HIST_BUCKETS - 1;
+			sched_wake_hist[bucket]++;
+			if (wait > next->sched.max_wake_latency)
+				next->sched.max_wake_latency = wait;
+			next->sched.woken = false;
+		}
+		next->sched.dispatches++;
+	}
+	next->sched.run_tsc = now;
+}
+
+/* Copies the running thread's scheduling statistics into OUT,
+   with its current run included up to now. */
+void
+thread_sched_stats (struct sched_stats *out) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	*out = cur->sched;
+	out->run_cycles += rdtsc () - cur->sched.run_tsc;
+	intr_set_level (old_level);
+}
+
+/* Copies the system-wide wake-to-run latency histogram into
+   HIST. */
+void
+thread_sched_histogram (uint64_t hist[SCHED_HIST_BUCKETS]) {
+	enum intr_level old_level = intr_disable ();
+
+	memcpy (hist, sched_wake_hist, sizeof sched_wake_hist);
+	intr_set_level (old_level);
+}
+
+/* Prints the scheduling latency statistics: totals by reason for
+   leaving the CPU, the wake-to-run histogram, and a line per
+   live thread. */
+void
+thread_print_sched_stats (void) {
+	struct list_elem *e;
+	int b, last;
+
+	printf ("Scheduler: %lld preempt, %lld block, %lld yield, %lld exit\n",
+			sched_leaves[SCHED_PREEMPT], sched_leaves[SCHED_BLOCK],
+			sched_leaves[SCHED_YIELD], sched_leaves[SCHED_EXIT]);
+
+	for (last = SCHED_HIST_BUCKETS - 1; last > 0; last--)
+		if (sched_wake_hist[last] != 0)
+			break;
+	printf ("Wake-to-run latency (cycles):\n");
+	for (b = 0; b <= last; b++)
+		if (sched_wake_hist[b] != 0)
+			printf ("  [2^%-2d, 2^%-2d) %"PRIu64"\n", b, b + 1, sched_wake_hist[b]);
+
+	printf ("%-16s %5s %10s %14s %14s %14s\n",
+			"thread", "tid", "dispatch", "wait cyc", "run cyc", "max wake");
+	for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, allelem);
+		printf ("%-16s %5d %10u %14"PRIu64" %14"PRIu64" %14"PRIu64"\n",
+				t->name, t->tid, t->sched.dispatches, t->sched.wait_cycles,
+				t->sched.run_cycles, t->sched.max_wake_latency);
+	}
+}
+
+/* Returns a page for a new thread.  A recycled page is only
+   guaranteed to be clean in its `struct thread' header, which
+   init_thread() clears; the stack area above it holds whatever
+   the previous owner left there.  Returns a null pointer if no
+   memory is available. */
+static struct thread *
+thread_page_alloc (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level = intr_disable ();
+
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+		thread_cache_hits++;
+	} else
+		thread_cache_misses++;
+	intr_set_level (old_level);
+
+	if (t == NULL)
+		t = palloc_get_page (PAL_ZERO);
+	return t;
+}
+
+/* Releases the page of dead thread T into the thread cache.
+   Interrupts must be off. */
+static void
+thread_page_free (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_push_front (&thread_cache, &t->elem);
+	if (++thread_cache_cnt > thread_cache_high)
+		thread_cache_high = thread_cache_cnt;
+}
+
+/* Gives the pages in the thread cache beyond THREAD_CACHE_MAX
+   back to the page allocator.  Must not be called from the
+   scheduler. */
+static void
+thread_cache_trim (void) {
+	for (;;) {
+		struct thread *t = NULL;
+		enum intr_level old_level = intr_disable ();
+
+		if (thread_cache_cnt > THREAD_CACHE_MAX) {
+			t = list_entry (list_pop_back (&thread_cache), struct thread, elem);
+			thread_cache_cnt--;
+			thread_cache_frees++;
+		}
+		intr_set_level (old_level);
+
+		if (t == NULL)
+			break;
+		palloc_free_page (t);
+	}
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
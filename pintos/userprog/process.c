@@ -19,6 +19,8 @@
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #ifdef VM
+#include "threads/malloc.h"
+#include "threads/synch.h"
 #include "vm/vm.h"
 #endif
 
@@ -574,11 +576,191 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
+/* A loadable ELF segment whose pages are read in lazily.  Each
+ * of its pages that is not yet loaded holds a reference to it,
+ * including the copies fork makes, and the last one to be loaded
+ * or freed frees it.
+ *
+ * A fault in the segment also reads in the pages that follow,
+ * up to WINDOW of them that are not loaded yet, with a single
+ * file_read_at(), and maps them.  At the segment's next fault,
+ * the window doubles if every one of those pages has been
+ * accessed since, and halves if fewer than half have, so a
+ * sequential scan soon takes one fault per FAULT_AROUND_MAX + 1
+ * pages while scattered accesses stop reading pages that are not
+ * used. */
+struct segment {
+	struct file *file;          /* Executable, reopened for the segment. */
+	off_t ofs;                  /* File offset of the first page. */
+	uint8_t *upage;             /* User address of the first page. */
+	size_t read_bytes;          /* Bytes to read; the rest are zero. */
+
+	struct lock lock;           /* Protects the members below. */
+	unsigned ref_cnt;           /* References to the segment. */
+	size_t window;              /* Pages to read after a faulting one. */
+	struct thread *ra_owner;    /* Thread that read the last window... */
+	uint8_t *ra_start;          /* ...the first page of it... */
+	size_t ra_cnt;              /* ...and how many pages it read. */
+};
+
+#define FAULT_AROUND_INIT 4     /* Initial window, in pages. */
+#define FAULT_AROUND_MAX 16     /* Largest window. */
+
+/* A page of a segment whose contents were read in with another
+ * page's, on its way in through fill_page(). */
+struct prefill {
+	struct segment *seg;
+	const void *src;            /* The page's contents. */
+};
+
+/* Adds a reference to struct segment AUX, for a copy of one of
+ * its pages. */
+void
+segment_get (void *aux) {
+	struct segment *seg = aux;
+
+	lock_acquire (&seg->lock);
+	seg->ref_cnt++;
+	lock_release (&seg->lock);
+}
+
+/* Drops a reference to struct segment AUX, freeing it if it was
+ * the last. */
+void
+segment_put (void *aux) {
+	struct segment *seg = aux;
+	bool last;
+
+	lock_acquire (&seg->lock);
+	last = --seg->ref_cnt == 0;
+	lock_release (&seg->lock);
+	if (last) {
+		file_close (seg->file);
+		free (seg);
+	}
+}
+
+/* Returns true if PAGE is a page of SEG that is not loaded yet. */
+static bool
+is_unloaded (const struct page *page, const struct segment *seg) {
+	return (page != NULL && VM_TYPE (page->operations->type) == VM_UNINIT
+			&& page->uninit.aux == seg);
+}
+
+/* Reads CNT pages of SEG, starting at page IDX, into BUF, with one
+ * file read.  Returns true if successful. */
+static bool
+read_pages (struct segment *seg, size_t idx, size_t cnt, uint8_t *buf) {
+	size_t start = idx * PGSIZE;
+	size_t len = 0;
+
+	if (seg->read_bytes > start)
+		len = seg->read_bytes - start < cnt * PGSIZE
+			? seg->read_bytes - start : cnt * PGSIZE;
+	if (len > 0
+			&& file_read_at (seg->file, buf, len, seg->ofs + start) != (off_t) len)
+		return false;
+	memset (buf + len, 0, cnt * PGSIZE - len);
+	return true;
+}
+
+/* Adapts SEG's window to how many of the pages read around its
+ * last fault have been used.  SEG's lock must be held. */
+static void
+adapt_window (struct segment *seg) {
+	struct thread *t = thread_current ();
+	size_t used = 0;
+	size_t i;
+
+	if (seg->ra_owner != t || seg->ra_cnt == 0)
+		return;
+	for (i = 0; i < seg->ra_cnt; i++) {
+		void *va = seg->ra_start + i * PGSIZE;
+		struct page *page = spt_find_page (&t->spt, va);
+
+		if (page != NULL && page->frame != NULL
+				&& pml4_is_accessed (t->pml4, va))
+			used++;
+	}
+	if (used == seg->ra_cnt && seg->window < FAULT_AROUND_MAX)
+		seg->window *= 2;
+	else if (used * 2 < seg->ra_cnt && seg->window > 1)
+		seg->window /= 2;
+	seg->ra_cnt = 0;
+}
+
+/* Initializer for a page whose contents are in the struct
+ * prefill AUX. */
+static bool
+fill_page (struct page *page, void *aux) {
+	struct prefill *prefill = aux;
+
+	memcpy (page->frame->kva, prefill->src, PGSIZE);
+	segment_put (prefill->seg);
+	return true;
+}
+
+/* Loads PAGE, a page of struct segment AUX, and reads in and maps
+ * the pages after it along with it. */
 static bool
 lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+	struct segment *seg = aux;
+	struct thread *t = thread_current ();
+	size_t idx = ((uint8_t *) page->va - seg->upage) / PGSIZE;
+	struct page *run[FAULT_AROUND_MAX];
+	size_t window, cnt, loaded;
+	uint8_t *buf = NULL;
+	bool success;
+
+	lock_acquire (&seg->lock);
+	adapt_window (seg);
+	window = seg->window;
+	lock_release (&seg->lock);
+
+	/* Find the pages after PAGE that are still to be loaded. */
+	for (cnt = 0; cnt < window; cnt++) {
+		run[cnt] = spt_find_page (&t->spt,
+				(uint8_t *) page->va + (cnt + 1) * PGSIZE);
+		if (!is_unloaded (run[cnt], seg))
+			break;
+	}
+	if (cnt > 0)
+		buf = palloc_get_multiple (0, cnt + 1);
+
+	if (buf == NULL) {
+		success = read_pages (seg, idx, 1, page->frame->kva);
+		segment_put (seg);
+		return success;
+	}
+
+	/* Read them all at once, then map each page that a free frame
+	   can be found for, in order. */
+	success = read_pages (seg, idx, cnt + 1, buf);
+	if (success) {
+		memcpy (page->frame->kva, buf, PGSIZE);
+		for (loaded = 0; loaded < cnt; loaded++) {
+			struct uninit_page *uninit = &run[loaded]->uninit;
+			struct prefill prefill = { seg, buf + (loaded + 1) * PGSIZE };
+			vm_initializer *init = uninit->init;
+
+			uninit->init = fill_page;
+			uninit->aux = &prefill;
+			if (!vm_prefetch_page (run[loaded])) {
+				uninit->init = init;
+				uninit->aux = seg;
+				break;
+			}
+		}
+
+		lock_acquire (&seg->lock);
+		seg->ra_owner = t;
+		seg->ra_start = (uint8_t *) page->va + PGSIZE;
+		seg->ra_cnt = loaded;
+		lock_release (&seg->lock);
+	}
+	palloc_free_multiple (buf, cnt + 1);
+	segment_put (seg);
+	return success;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -602,6 +784,25 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
+	struct segment *seg = malloc (sizeof *seg);
+	bool success = true;
+
+	if (seg == NULL)
+		return false;
+	seg->file = file_reopen (file);
+	if (seg->file == NULL) {
+		free (seg);
+		return false;
+	}
+	seg->ofs = ofs;
+	seg->upage = upage;
+	seg->read_bytes = read_bytes;
+	lock_init (&seg->lock);
+	seg->ref_cnt = 1;             /* Ours, until the pages are set up. */
+	seg->window = FAULT_AROUND_INIT;
+	seg->ra_owner = NULL;
+	seg->ra_cnt = 0;
+
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
@@ -609,18 +810,21 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
-			return false;
+		segment_get (seg);
+		if (!vm_alloc_page_with_initializer (VM_ANON | VM_SEGMENT, upage,
+					writable, lazy_load_segment, seg)) {
+			segment_put (seg);
+			success = false;
+			break;
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
 	}
-	return true;
+	segment_put (seg);
+	return success;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -629,11 +833,13 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
-
+	/* Claim the page right away instead of on its first fault, so
+	 * that the kernel can write to it during load(). */
+	if (vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)) {
+		success = vm_claim_page (stack_bottom);
+		if (success)
+			if_->rsp = USER_STACK;
+	}
 	return success;
 }
 #endif /* VM */
@@ -1,7 +1,13 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <stdio.h>
+#include <string.h>
 #include "vm/vm.h"
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,11 +23,74 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* The swap disk is divided into page-sized slots.
+
+   Slots are handed out in clusters, so that the pages one
+   process evicts one after another land in adjacent slots: each
+   table remembers the slot after the last one it used, and takes
+   that one if it is still free.  Otherwise it starts a new
+   cluster at the next run of CLUSTER_SLOTS free slots after the
+   previous cluster, which leaves the rest of the run free for it
+   to grow into.
+
+   Since a process's neighbouring slots then usually hold pages
+   it evicted together, and so tends to use together, a swap-in
+   also reads in the process's other swapped-out pages in the
+   surrounding slots, in slot order.  The disk sees one run of
+   sequential multi-sector reads instead of a random read per
+   fault.  Pages read in this way take only free frames, so they
+   never push out a page in use.
+
+   After fork, a parent and child may share a swapped-out page,
+   and so its slot.  A slot is freed when the last page in it is
+   swapped in or freed.  A shared slot is left out of the reverse
+   map, so it is never read around.
+
+   swap_lock protects the slot map, the reference counts, the
+   reverse map, the cursor and every table's SWAP_HINT.  It is
+   taken with frame_lock held, never the other way around. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+#define CLUSTER_SLOTS 16        /* Slots in a new cluster. */
+#define READ_AROUND 8           /* Most slots read per swap-in. */
+
+static struct bitmap *swap_map;     /* Set bit = slot in use. */
+static unsigned *slot_refs;         /* Pages in each slot. */
+static struct page **slot_pages;    /* Page in each unshared slot. */
+static size_t slot_cnt;
+static size_t cluster_cursor;       /* Where to look for a new cluster. */
+static struct lock swap_lock;
+
+/* Statistics. */
+static unsigned long long swap_out_cnt;     /* Pages written. */
+static unsigned long long clustered_cnt;    /* ...to the slot after the last. */
+static unsigned long long swap_in_cnt;      /* Pages read on a fault. */
+static unsigned long long read_around_cnt;  /* Pages read around them. */
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_disk = disk_get (1, 1);
+	lock_init_named (&swap_lock, "swap");
+	if (swap_disk == NULL)
+		return;
+
+	slot_cnt = disk_size (swap_disk) / SECTORS_PER_SLOT;
+	swap_map = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	slot_pages = calloc (slot_cnt, sizeof *slot_pages);
+	if (swap_map == NULL || slot_refs == NULL || slot_pages == NULL)
+		PANIC ("vm_anon_init: out of memory");
+}
+
+/* Prints swap statistics. */
+void
+anon_print_stats (void) {
+	if (swap_disk == NULL)
+		return;
+	printf ("Swap: %zu slots, %llu pages out (%llu clustered), "
+			"%llu pages in (%llu read around)\n",
+			slot_cnt, swap_out_cnt, clustered_cnt, swap_in_cnt,
+			read_around_cnt);
 }
 
 /* Initialize the file mapping */
@@ -31,22 +100,180 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = SWAP_NONE;
+	anon_page->prefetch = false;
+	return true;
+}
+
+/* Allocates a swap slot for PAGE and records PAGE in it.
+   Returns the slot, or SWAP_NONE if swap is full.  swap_lock
+   must be held. */
+static size_t
+slot_alloc (struct page *page) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	size_t slot = spt->swap_hint;
+
+	if (slot < slot_cnt && !bitmap_test (swap_map, slot))
+		clustered_cnt++;
+	else {
+		slot = bitmap_scan (swap_map, cluster_cursor, CLUSTER_SLOTS, false);
+		if (slot == BITMAP_ERROR)
+			slot = bitmap_scan (swap_map, 0, CLUSTER_SLOTS, false);
+		if (slot == BITMAP_ERROR)
+			slot = bitmap_scan (swap_map, 0, 1, false);
+		if (slot == BITMAP_ERROR)
+			return SWAP_NONE;
+		cluster_cursor = (slot + CLUSTER_SLOTS) % slot_cnt;
+	}
+
+	bitmap_mark (swap_map, slot);
+	slot_refs[slot] = 1;
+	slot_pages[slot] = page;
+	spt->swap_hint = slot + 1;
+	return slot;
+}
+
+/* Drops a page's reference to SLOT, freeing it if no page is
+   left in it.  swap_lock must be held. */
+static void
+slot_put (size_t slot) {
+	ASSERT (bitmap_test (swap_map, slot));
+	ASSERT (slot_refs[slot] > 0);
+
+	if (--slot_refs[slot] == 0) {
+		bitmap_reset (swap_map, slot);
+		slot_pages[slot] = NULL;
+	}
+}
+
+/* Returns the page in SLOT if it belongs to the current thread
+   and is swapped out, or a null pointer otherwise.  swap_lock
+   must be held. */
+static struct page *
+neighbour (size_t slot) {
+	struct page *page = slot_pages[slot];
+
+	/* A page whose frame is still set is being written out. */
+	if (page == NULL || page->owner != thread_current ()
+			|| page->frame != NULL || page->anon.slot != slot)
+		return NULL;
+	return page;
+}
+
+/* Reads the page in SLOT into KVA. */
+static void
+slot_read (size_t slot, void *kva) {
+	disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT,
+			kva);
+}
+
+/* Makes anonymous page PAGE, which is not in memory, share the
+   swap slot of SRC, which must be swapped out. */
+void
+anon_share_slot (struct page *page, struct page *src) {
+	size_t slot = src->anon.slot;
+
+	ASSERT (slot != SWAP_NONE);
+	ASSERT (page->anon.slot == SWAP_NONE);
+
+	lock_acquire (&swap_lock);
+	slot_refs[slot]++;
+	slot_pages[slot] = NULL;
+	page->anon.slot = slot;
+	lock_release (&swap_lock);
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	size_t slot = anon_page->slot;
+	struct page *run[READ_AROUND];
+	size_t lo, hi, s;
+
+	/* A page never swapped out starts zeroed. */
+	if (slot == SWAP_NONE) {
+		memset (kva, 0, PGSIZE);
+		return true;
+	}
+
+	/* A page being read around another just reads itself. */
+	if (anon_page->prefetch) {
+		anon_page->prefetch = false;
+		slot_read (slot, kva);
+		lock_acquire (&swap_lock);
+		slot_put (slot);
+		anon_page->slot = SWAP_NONE;
+		read_around_cnt++;
+		lock_release (&swap_lock);
+		return true;
+	}
+
+	/* Find the run of this process's swapped-out pages around
+	   SLOT, at most READ_AROUND slots long, and mark them. */
+	lock_acquire (&swap_lock);
+	lo = hi = slot;
+	while (hi + 1 < slot_cnt && hi + 1 - lo < READ_AROUND
+			&& neighbour (hi + 1) != NULL)
+		hi++;
+	while (lo > 0 && hi + 1 - lo < READ_AROUND && neighbour (lo - 1) != NULL)
+		lo--;
+	for (s = lo; s <= hi; s++) {
+		run[s - lo] = slot_pages[s];
+		if (s != slot)
+			run[s - lo]->anon.prefetch = true;
+	}
+	lock_release (&swap_lock);
+
+	/* Read the run in slot order.  Only this thread frees or swaps
+	   in its own pages, so the marked pages stay in their slots. */
+	for (s = lo; s <= hi; s++) {
+		struct page *p = run[s - lo];
+
+		if (s == slot) {
+			slot_read (slot, kva);
+			lock_acquire (&swap_lock);
+			slot_put (slot);
+			anon_page->slot = SWAP_NONE;
+			swap_in_cnt++;
+			lock_release (&swap_lock);
+		} else if (!vm_prefetch_page (p))
+			p->anon.prefetch = false;
+	}
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	size_t slot;
+
+	if (swap_disk == NULL)
+		return false;
+
+	lock_acquire (&swap_lock);
+	slot = slot_alloc (page);
+	lock_release (&swap_lock);
+	if (slot == SWAP_NONE)
+		return false;
+
+	disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT,
+			page->frame->kva);
+	anon_page->slot = slot;
+	swap_out_cnt++;
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->slot == SWAP_NONE)
+		return;
+	lock_acquire (&swap_lock);
+	slot_put (anon_page->slot);
+	anon_page->slot = SWAP_NONE;
+	lock_release (&swap_lock);
 }
@@ -0,0 +1,326 @@
+/* spt.c: Supplemental page table.
+ *
+ * The table is a radix tree indexed by virtual page number, with
+ * the same shape as the x86-64 page table: four levels of
+ * 512-entry nodes, each node one page, and each level consuming
+ * 9 bits of the address, from bits 39-47 at the top down to bits
+ * 12-20 at the leaves.  A leaf entry points to a struct page.  A
+ * lookup is therefore four dependent loads with no hashing and
+ * no comparisons, and a process whose pages are clustered in a
+ * few regions (code, data, stack, mappings) needs only a handful
+ * of nodes.
+ *
+ * Every node keeps a count of its non-empty entries so that it
+ * can be freed as soon as it becomes empty.  Nodes are page
+ * aligned, so, like a page-table entry, the entry that points to
+ * a node keeps the node's count in its low 12 bits.  The count
+ * of the top node is kept the same way in the table's ROOT.
+ *
+ * Range operations recurse only into entries that are non-empty,
+ * so their cost depends on how many pages are in the range, not
+ * on how large the range is.
+ *
+ * A table is used only by the thread that owns it, or by a child
+ * copying it in fork while the owner waits, so it needs no lock. */
+
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+#define SPT_LEVELS 4                    /* Levels in the tree. */
+#define SPT_BITS 9                      /* Address bits per level. */
+#define SPT_FANOUT (1 << SPT_BITS)      /* Entries per node. */
+#define CNT_MASK ((uintptr_t) PGMASK)   /* Count bits of a tagged entry. */
+
+/* Totals over all tables, for spt_print_stats().  Updated with
+   interrupts off. */
+static size_t total_pages;
+static size_t total_nodes;
+static size_t peak_nodes;
+
+/* Returns the node that tagged entry E points to. */
+static inline uintptr_t *
+node_of (uintptr_t e) {
+	return (uintptr_t *) (e & ~CNT_MASK);
+}
+
+/* Returns the entry count of the node that tagged entry E points
+   to. */
+static inline size_t
+cnt_of (uintptr_t e) {
+	return e & CNT_MASK;
+}
+
+/* Returns the index into a node at LEVEL, where 0 is the leaves,
+   for virtual address VA. */
+static inline size_t
+index_at (uintptr_t va, int level) {
+	return (va >> (PGBITS + level * SPT_BITS)) & (SPT_FANOUT - 1);
+}
+
+/* Returns the number of bytes of address space that one entry of
+   a node at LEVEL covers. */
+static inline uintptr_t
+span_at (int level) {
+	return (uintptr_t) PGSIZE << (level * SPT_BITS);
+}
+
+/* Adds DELTA to the global page and node counts. */
+static void
+count (long page_delta, long node_delta) {
+	enum intr_level old_level = intr_disable ();
+
+	total_pages += page_delta;
+	total_nodes += node_delta;
+	if (total_nodes > peak_nodes)
+		peak_nodes = total_nodes;
+	intr_set_level (old_level);
+}
+
+/* Allocates an empty node for SPT and stores it in *REF.  Returns
+   true if successful, false if memory is not available. */
+static bool
+node_create (struct supplemental_page_table *spt, uintptr_t *ref) {
+	uintptr_t *node = palloc_get_page (PAL_ZERO);
+
+	if (node == NULL)
+		return false;
+	*ref = (uintptr_t) node;
+	spt->node_cnt++;
+	count (0, 1);
+	return true;
+}
+
+/* Frees the node that *REF points to, which must be empty, and
+   clears *REF. */
+static void
+node_free (struct supplemental_page_table *spt, uintptr_t *ref) {
+	ASSERT (cnt_of (*ref) == 0);
+
+	palloc_free_page (node_of (*ref));
+	*ref = 0;
+	spt->node_cnt--;
+	count (0, -1);
+}
+
+/* Frees the empty nodes on a path through SPT, from the node at
+   FROM_LEVEL upward.  REFS[L] is the entry that points to the
+   path's node at level L. */
+static void
+prune (struct supplemental_page_table *spt, uintptr_t *refs[],
+		int from_level) {
+	int level;
+
+	for (level = from_level; level < SPT_LEVELS; level++) {
+		if (cnt_of (*refs[level]) != 0)
+			break;
+		node_free (spt, refs[level]);
+		if (level + 1 < SPT_LEVELS)
+			*refs[level + 1] -= 1;
+	}
+}
+
+/* Finds the leaf entry for VA in SPT and fills in REFS as for
+   prune().  Returns a null pointer if a node on the path is
+   missing. */
+static uintptr_t *
+find_slot (struct supplemental_page_table *spt, uintptr_t va,
+		uintptr_t *refs[]) {
+	uintptr_t *ref = &spt->root;
+	int level;
+
+	for (level = SPT_LEVELS - 1; level >= 0; level--) {
+		if (*ref == 0)
+			return NULL;
+		refs[level] = ref;
+		ref = &node_of (*ref)[index_at (va, level)];
+	}
+	return ref;
+}
+
+/* Initialize new supplemental page table */
+void
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->root = 0;
+	spt->page_cnt = 0;
+	spt->node_cnt = 0;
+	spt->swap_hint = 0;
+}
+
+/* Find VA from spt and return page. On error, return NULL. */
+struct page *
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	uintptr_t e = spt->root;
+	int level;
+
+	if (!is_user_vaddr (va))
+		return NULL;
+	for (level = SPT_LEVELS - 1; level > 0; level--) {
+		if (e == 0)
+			return NULL;
+		e = node_of (e)[index_at ((uintptr_t) va, level)];
+	}
+	return e != 0 ? (struct page *) node_of (e)[index_at ((uintptr_t) va, 0)]
+		: NULL;
+}
+
+/* Insert PAGE into spt with validation.  Fails if PAGE->va is not
+   a page-aligned user address, if another page is already at
+   that address, or if memory for a node is not available. */
+bool
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	uintptr_t va = (uintptr_t) page->va;
+	uintptr_t *refs[SPT_LEVELS];
+	uintptr_t *ref = &spt->root;
+	int level;
+
+	if (pg_ofs (va) != 0 || !is_user_vaddr (va))
+		return false;
+
+	for (level = SPT_LEVELS - 1; level >= 0; level--) {
+		if (*ref == 0) {
+			if (!node_create (spt, ref)) {
+				prune (spt, refs, level + 1);
+				return false;
+			}
+			if (level + 1 < SPT_LEVELS)
+				*refs[level + 1] += 1;
+		}
+		refs[level] = ref;
+		ref = &node_of (*ref)[index_at (va, level)];
+	}
+
+	if (*ref != 0) {
+		prune (spt, refs, 0);
+		return false;
+	}
+	*ref = (uintptr_t) page;
+	*refs[0] += 1;
+	spt->page_cnt++;
+	count (1, 0);
+	return true;
+}
+
+/* Removes PAGE, which must be in SPT, from SPT without freeing
+   it, and frees any nodes this leaves empty. */
+void
+spt_detach_page (struct supplemental_page_table *spt, struct page *page) {
+	uintptr_t *refs[SPT_LEVELS];
+	uintptr_t *slot = find_slot (spt, (uintptr_t) page->va, refs);
+
+	ASSERT (slot != NULL && *slot == (uintptr_t) page);
+
+	*slot = 0;
+	*refs[0] -= 1;
+	prune (spt, refs, 0);
+	spt->page_cnt--;
+	count (-1, 0);
+}
+
+/* Removes PAGE, which must be in SPT, from SPT and frees it. */
+void
+spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	spt_detach_page (spt, page);
+	vm_dealloc_page (page);
+}
+
+/* Calls ACTION on each page of the subtree that tagged entry E
+   points to, at LEVEL and covering addresses from BASE, that
+   lies in [START, END). */
+static void
+walk (uintptr_t e, int level, uintptr_t base, uintptr_t start,
+		uintptr_t end, spt_action_func *action, void *aux) {
+	uintptr_t *node = node_of (e);
+	uintptr_t span = span_at (level);
+	size_t first = start > base ? (start - base) / span : 0;
+	size_t last = (end - 1 - base) / span;
+	size_t i;
+
+	if (last >= SPT_FANOUT)
+		last = SPT_FANOUT - 1;
+	for (i = first; i <= last; i++) {
+		if (node[i] == 0)
+			continue;
+		if (level == 0)
+			action ((struct page *) node[i], aux);
+		else
+			walk (node[i], level - 1, base + i * span, start, end, action, aux);
+	}
+}
+
+/* Calls ACTION, in address order, on each page in SPT whose
+   address is in [START, END).  ACTION must not add pages to or
+   remove pages from SPT. */
+void
+spt_walk (struct supplemental_page_table *spt, void *start, void *end,
+		spt_action_func *action, void *aux) {
+	if (spt->root != 0 && start < end)
+		walk (spt->root, SPT_LEVELS - 1, 0, (uintptr_t) start,
+				(uintptr_t) end, action, aux);
+}
+
+/* Like walk(), but removes each page from the subtree before
+   passing it to ACTION, and frees the nodes it empties.  *REF is
+   the tagged entry that points to the subtree. */
+static void
+clear (struct supplemental_page_table *spt, uintptr_t *ref, int level,
+		uintptr_t base, uintptr_t start, uintptr_t end,
+		spt_action_func *action, void *aux) {
+	uintptr_t *node = node_of (*ref);
+	uintptr_t span = span_at (level);
+	size_t first = start > base ? (start - base) / span : 0;
+	size_t last = (end - 1 - base) / span;
+	size_t i;
+
+	if (last >= SPT_FANOUT)
+		last = SPT_FANOUT - 1;
+	for (i = first; i <= last; i++) {
+		if (node[i] == 0)
+			continue;
+		if (level == 0) {
+			struct page *page = (struct page *) node[i];
+
+			node[i] = 0;
+			*ref -= 1;
+			spt->page_cnt--;
+			count (-1, 0);
+			action (page, aux);
+		} else {
+			clear (spt, &node[i], level - 1, base + i * span, start, end,
+					action, aux);
+			if (cnt_of (node[i]) == 0) {
+				node_free (spt, &node[i]);
+				*ref -= 1;
+			}
+		}
+	}
+}
+
+/* Removes each page in SPT whose address is in [START, END) and
+   passes it to ACTION, in address order.  ACTION is responsible
+   for freeing the page and must not use SPT. */
+void
+spt_clear_range (struct supplemental_page_table *spt, void *start,
+		void *end, spt_action_func *action, void *aux) {
+	if (spt->root == 0 || start >= end)
+		return;
+	clear (spt, &spt->root, SPT_LEVELS - 1, 0, (uintptr_t) start,
+			(uintptr_t) end, action, aux);
+	if (cnt_of (spt->root) == 0)
+		node_free (spt, &spt->root);
+}
+
+/* Prints statistics about all supplemental page tables. */
+void
+spt_print_stats (void) {
+	enum intr_level old_level = intr_disable ();
+	size_t pages = total_pages, nodes = total_nodes, peak = peak_nodes;
+
+	intr_set_level (old_level);
+	printf ("SPT: %zu pages mapped, %zu nodes (peak %zu), "
+			"%zu bytes of nodes per mapped page\n",
+			pages, nodes, peak, pages ? nodes * PGSIZE / pages : 0);
+}